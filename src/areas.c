@@ -11,13 +11,29 @@
 #include "obj.h"
 
 #include "utarray.h"
+#include "uthash.h"
 #include "utils/vec.h"
 #include "utils/utils.h"
 
 #include <assert.h>
 #include <math.h>
 
+/*
+ * The items are indexed in a uniform screen space grid, so that a lookup
+ * only has to test the items close to the searched position.  Since we
+ * don't know the screen size, the grid cells are stored in a hash table
+ * keyed by the cell coordinates.  The cells are kept when we clear the
+ * areas, so that after the first frames adding an item doesn't allocate
+ * anything.
+ */
+
+#define CELL_SIZE 32 // In window pixels.
+// Items covering more cells than that are put in a separate list that we
+// always check.
+#define MAX_ITEM_CELLS 64
+
 typedef struct item item_t;
+typedef struct cell cell_t;
 
 struct item
 {
@@ -28,9 +44,20 @@ struct item
     obj_t  *obj;
 };
 
+struct cell
+{
+    UT_hash_handle  hh;
+    int             key[2];
+    int             nb;
+    int             capacity;
+    int             *items; // Index of the items in the areas array.
+};
+
 struct areas
 {
     UT_array *items;
+    cell_t   *cells;    // Hash table of the grid cells.
+    cell_t   big;       // Items too big to be put in the grid.
 };
 
 /*
@@ -66,6 +93,60 @@ areas_t *areas_create(void)
     return areas;
 }
 
+// Compute the range of cells covered by a square.
+// Return false if the square is not valid.
+static bool get_cells_range(const double center[2], double r, int range[4])
+{
+    int i;
+    double v;
+    if (isnan(center[0]) || isnan(center[1]) || isnan(r)) return false;
+    for (i = 0; i < 4; i++) {
+        v = center[i % 2] + (i < 2 ? -r : +r);
+        // Clamp to prevent int overflow for points far outside the screen.
+        range[i] = floor(clamp(v / CELL_SIZE, -1 << 20, 1 << 20));
+    }
+    return true;
+}
+
+static void cell_add(cell_t *cell, int idx)
+{
+    if (cell->nb == cell->capacity) {
+        cell->capacity = cell->capacity ? cell->capacity * 2 : 8;
+        cell->items = realloc(cell->items,
+                              cell->capacity * sizeof(*cell->items));
+    }
+    cell->items[cell->nb++] = idx;
+}
+
+static void add_item(areas_t *areas, const item_t *item)
+{
+    int idx, x, y, key[2], range[4];
+    cell_t *cell;
+
+    utarray_push_back(areas->items, item);
+    idx = utarray_len(areas->items) - 1;
+    if (!get_cells_range(item->pos, fmax(item->a, item->b), range))
+        return; // Can never be found anyway.
+
+    if ((range[2] - range[0] + 1) * (range[3] - range[1] + 1) >
+            MAX_ITEM_CELLS) {
+        cell_add(&areas->big, idx);
+        return;
+    }
+    for (y = range[1]; y <= range[3]; y++)
+    for (x = range[0]; x <= range[2]; x++) {
+        key[0] = x;
+        key[1] = y;
+        HASH_FIND(hh, areas->cells, key, sizeof(key), cell);
+        if (!cell) {
+            cell = calloc(1, sizeof(*cell));
+            memcpy(cell->key, key, sizeof(key));
+            HASH_ADD(hh, areas->cells, key, sizeof(cell->key), cell);
+        }
+        cell_add(cell, idx);
+    }
+}
+
 void areas_add_circle(areas_t *areas, const double pos[2], double r,
                       const obj_t *obj)
 {
@@ -73,7 +154,7 @@ void areas_add_circle(areas_t *areas, const double pos[2], double r,
     memcpy(item.pos, pos, sizeof(item.pos));
     item.a = item.b = r;
     item.obj = obj_retain(obj);
-    utarray_push_back(areas->items, &item);
+    add_item(areas, &item);
 }
 
 void areas_add_ellipse(areas_t *areas, const double pos[2], double angle,
@@ -85,16 +166,29 @@ void areas_add_ellipse(areas_t *areas, const double pos[2], double angle,
     item.a = a;
     item.b = b;
     item.obj = obj_retain(obj);
-    utarray_push_back(areas->items, &item);
+    add_item(areas, &item);
 }
 
 void areas_clear_all(areas_t *areas)
 {
     item_t *item = NULL;
+    cell_t *cell, *tmp;
     while ( (item = (item_t*)utarray_next(areas->items, item)) ) {
         obj_release(item->obj);
     }
     utarray_clear(areas->items);
+    HASH_ITER(hh, areas->cells, cell, tmp) {
+        // Remove the cells that have not been used for the last frame,
+        // so that the table doesn't keep growing when the view moves.
+        if (cell->nb == 0) {
+            HASH_DEL(areas->cells, cell);
+            free(cell->items);
+            free(cell);
+            continue;
+        }
+        cell->nb = 0;
+    }
+    areas->big.nb = 0;
 }
 
 /*
@@ -126,18 +220,154 @@ static double lookup_score(const item_t *item, const double pos[static 2],
 
 }
 
+typedef struct {
+    int     idx;
+    double  score;
+} result_t;
+
+// Add an item to the list of the n best results, sorted by score.
+// In case of equal scores, the first added item wins.
+static int results_add(result_t *results, int nb, int n, int idx,
+                       double score)
+{
+    int i;
+    if (score <= 0.0) return nb;
+    for (i = 0; i < nb; i++) {
+        if (results[i].idx == idx) return nb; // Already there.
+    }
+    for (i = nb; i > 0; i--) {
+        if (    results[i - 1].score > score ||
+                (results[i - 1].score == score && results[i - 1].idx < idx))
+            break;
+        if (i < n) results[i] = results[i - 1];
+    }
+    if (i >= n) return nb;
+    results[i].idx = idx;
+    results[i].score = score;
+    return nb < n ? nb + 1 : n;
+}
+
+static int lookup_cell(const areas_t *areas, const cell_t *cell,
+                       const double pos[2], double max_dist,
+                       int n, result_t *results, int nb)
+{
+    int i;
+    const item_t *item;
+    for (i = 0; i < cell->nb; i++) {
+        item = (item_t*)utarray_eltptr(areas->items, cell->items[i]);
+        nb = results_add(results, nb, n, cell->items[i],
+                         lookup_score(item, pos, max_dist));
+    }
+    return nb;
+}
+
+// Fill results with the indices of the n best items.
+static int lookup(const areas_t *areas, const double pos[2], double max_dist,
+                  int n, result_t *results)
+{
+    int nb = 0, x, y, key[2], range[4];
+    const cell_t *cell, *tmp;
+
+    if (!get_cells_range(pos, max_dist, range)) return 0;
+    nb = lookup_cell(areas, &areas->big, pos, max_dist, n, results, nb);
+
+    // If the search area is larger than the cells we have, it's faster
+    // to test all of them.
+    if ((double)(range[2] - range[0] + 1) * (range[3] - range[1] + 1) >
+            HASH_COUNT(areas->cells)) {
+        HASH_ITER(hh, areas->cells, cell, tmp)
+            nb = lookup_cell(areas, cell, pos, max_dist, n, results, nb);
+        return nb;
+    }
+
+    for (y = range[1]; y <= range[3]; y++)
+    for (x = range[0]; x <= range[2]; x++) {
+        key[0] = x;
+        key[1] = y;
+        HASH_FIND(hh, areas->cells, key, sizeof(key), cell);
+        if (cell)
+            nb = lookup_cell(areas, cell, pos, max_dist, n, results, nb);
+    }
+    return nb;
+}
+
 obj_t *areas_lookup(const areas_t *areas, const double pos[2], double max_dist)
 {
-    item_t *item = NULL, *best = NULL;
-    double score, best_score = 0.0;
+    obj_t *ret;
+    if (areas_lookup_n(areas, pos, max_dist, 1, &ret) == 0) return NULL;
+    return ret;
+}
+
+int areas_lookup_n(const areas_t *areas, const double pos[2], double max_dist,
+                   int n, obj_t **out)
+{
+    int i, nb;
+    result_t *results;
+    const item_t *item;
 
-    while ( (item = (item_t*)utarray_next(areas->items, item)) ) {
-        score = lookup_score(item, pos, max_dist);
-        if (score > best_score) {
-            best_score = score;
-            best = item;
+    results = calloc(n, sizeof(*results));
+    nb = lookup(areas, pos, max_dist, n, results);
+    for (i = 0; i < nb; i++) {
+        item = (item_t*)utarray_eltptr(areas->items, results[i].idx);
+        out[i] = obj_retain(item->obj);
+    }
+    free(results);
+    return nb;
+}
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+// Check that the grid lookup gives the same results as testing all items.
+static void test_areas(void)
+{
+    int i, j, nb, best;
+    areas_t *areas;
+    double pos[2], score, best_score;
+    result_t results[4];
+    const item_t *item;
+
+    areas = areas_create();
+    srand(0);
+    for (i = 0; i < 10000; i++) {
+        pos[0] = rand() % 4000 - 1000;
+        pos[1] = rand() % 4000 - 1000;
+        if (i % 2)
+            areas_add_circle(areas, pos, rand() % 20, NULL);
+        else
+            areas_add_ellipse(areas, pos, rand() % 3,
+                              rand() % 500, rand() % 10, NULL);
+    }
+    for (i = 0; i < 1000; i++) {
+        pos[0] = rand() % 2000;
+        pos[1] = rand() % 2000;
+        best = -1;
+        best_score = 0;
+        for (j = 0; j < utarray_len(areas->items); j++) {
+            item = (item_t*)utarray_eltptr(areas->items, j);
+            score = lookup_score(item, pos, 10);
+            if (score > best_score) {
+                best_score = score;
+                best = j;
+            }
         }
+        nb = lookup(areas, pos, 10, ARRAY_SIZE(results), results);
+        assert((best == -1 && nb == 0) || results[0].idx == best);
+        for (j = 1; j < nb; j++)
+            assert(results[j].score <= results[j - 1].score);
     }
-    if (!best) return NULL;
-    return obj_retain(best->obj);
+    areas_clear_all(areas);
+    assert(lookup(areas, pos, 10, 1, results) == 0);
+    areas_clear_all(areas); // Also deletes all the unused cells.
+    assert(!areas->cells);
+    utarray_free(areas->items);
+    free(areas->big.items);
+    free(areas);
 }
+
+TEST_REGISTER(NULL, test_areas, TEST_AUTO);
+
+#endif
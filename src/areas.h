@@ -56,6 +56,24 @@ void areas_add_ellipse(areas_t *areas, const double pos[2], double angle,
  */
 obj_t *areas_lookup(const areas_t *areas, const double pos[2], double max_dist);
 
+/*
+ * Function: areas_lookup_n
+ * Get the n closest shapes at a given position in an areas.
+ *
+ * Parameters:
+ *   area       - an areas instance.
+ *   pos        - a 2d position in screen space.
+ *   max_dist   - max distance to shapes to consider.
+ *   n          - max number of objects to return.
+ *   out        - get the objects, sorted from the best match.  They need
+ *                to be released with obj_release.
+ *
+ * Return:
+ *   The number of objects found.
+ */
+int areas_lookup_n(const areas_t *areas, const double pos[2], double max_dist,
+                   int n, obj_t **out);
+
 /*
  * Function: areas_clear_all
  * Remove all the shapes in an areas instance.
@@ -10,6 +10,12 @@
 #include "swe.h"
 #include <sys/stat.h>
 
+#ifndef __EMSCRIPTEN__
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
 static const int DEFAULT_DELAY = 60;
 
 #ifdef __EMSCRIPTEN__
@@ -26,8 +32,12 @@ enum {
     FREE_DATA   = 1 << 10,
     LOGGED      = 1 << 11,
     CAN_RELEASE = 1 << 12,
+    MAPPED      = 1 << 13,
 };
 
+// Max number of hook functions.
+#define MAX_HOOKS 4
+
 typedef struct asset asset_t;
 struct asset
 {
@@ -41,16 +51,17 @@ struct asset
     int             size;
     int             last_used;
     int             delay;
+    double          priority;
 };
 
 // Global map of all the assets.
 static asset_t *g_assets = NULL;
 
-// Global hook function.
+// Global hook functions, called in order.
 static struct {
     void *user;
     void *(*fn)(void *user, const char *path, int *size, int *code);
-} g_hook = {};
+} g_hooks[MAX_HOOKS] = {};
 
 /*
  * Convenience function to log return code errors if needed.
@@ -77,14 +88,65 @@ static void remove_url_parameters(const char *url, char *out, int size)
         snprintf(out, size, "%.*s", (int)(pos - url), url);
 }
 
-static bool file_exists(const char *path)
+/*
+ * Map a local file in memory, or read it if mmap is not available.
+ *
+ * The assets data are expected to be null terminated, so we only map the
+ * files whose size is not a multiple of the page size: the end of the
+ * last page is then filled with zeros.
+ */
+static void *map_file(const char *path, int *size, bool *mapped)
+{
+#ifndef __EMSCRIPTEN__
+    int fd;
+    struct stat st;
+    void *data;
+
+    *mapped = false;
+    fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0 || st.st_size > INT32_MAX ||
+            st.st_size % sysconf(_SC_PAGESIZE) == 0) {
+        close(fd);
+        return read_file(path, size);
+    }
+    // Private writable mapping, in case some code modifies the data.
+    data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return read_file(path, size);
+    *size = st.st_size;
+    *mapped = true;
+    return data;
+#else
+    *mapped = false;
+    return read_file(path, size);
+#endif
+}
+
+// Mark the asset data as owned by the asset manager.
+static void own_data(asset_t *asset, int flags)
+{
+    asset->flags |= FREE_DATA | flags;
+    if (asset->data) cache_track_memory("assets", asset->size);
+}
+
+static void free_data(asset_t *asset)
 {
-    FILE *file;
-    if ((file = fopen(path, "r"))) {
-        fclose(file);
-        return true;
+    if (!asset->data) return;
+    cache_track_memory("assets", -asset->size);
+#ifndef __EMSCRIPTEN__
+    if (asset->flags & MAPPED) {
+        munmap(asset->data, asset->size);
+        asset->flags &= ~MAPPED;
+        return;
     }
-    return false;
+#endif
+    free(asset->data);
 }
 
 static asset_t *asset_get(const char *url, int flags)
@@ -131,7 +193,8 @@ const void *asset_get_data(const char *url, int *size, int *code)
 const void *asset_get_data2(const char *url, int flags, int *size, int *code)
 {
     asset_t *asset;
-    int r, default_size, default_code;
+    int i, r, default_size, default_code;
+    bool mapped;
     const void *data = NULL;
     (void)r;
     char path[1204];
@@ -159,15 +222,16 @@ const void *asset_get_data2(const char *url, int flags, int *size, int *code)
         r = z_uncompress(asset->data, asset->size,
                          asset->compressed_data + 4,
                          asset->compressed_size - 4);
-        asset->flags |= FREE_DATA;
+        own_data(asset, 0);
         assert(r == 0);
     }
 
-    // Apply hook if set.
-    if (g_hook.fn && !asset->request && !asset->data) {
-        asset->data = g_hook.fn(g_hook.user, url, &asset->size, code);
+    // Apply the hooks until one of them handles the url.
+    for (i = 0; i < MAX_HOOKS && g_hooks[i].fn; i++) {
+        if (asset->request || asset->data) break;
+        asset->data = g_hooks[i].fn(g_hooks[i].user, url, &asset->size, code);
         if (*code != -1) {
-            asset->flags |= FREE_DATA;
+            own_data(asset, 0);
             *size = asset->size;
             data = asset->data;
             goto end;
@@ -175,15 +239,19 @@ const void *asset_get_data2(const char *url, int flags, int *size, int *code)
         *code = 0;
     }
 
-    // Special handler for local files.
-    if (HAS_FS && !asset->data && !strchr(url, ':')) {
-        remove_url_parameters(url, path, sizeof(path));
-        if (!file_exists(path)) {
+    // Special handler for local files, that are directly mapped in memory
+    // without going through the requests.
+    if (HAS_FS && !asset->data &&
+            (!strchr(url, ':') || str_startswith(url, "file://"))) {
+        remove_url_parameters(str_startswith(url, "file://") ?
+                              url + strlen("file://") : url,
+                              path, sizeof(path));
+        asset->data = map_file(path, &asset->size, &mapped);
+        if (!asset->data) {
             *code = 404;
             goto end;
         }
-        asset->data = read_file(path, &asset->size);
-        asset->flags |= FREE_DATA;
+        own_data(asset, mapped ? MAPPED : 0);
     }
 
     if (asset->data) {
@@ -199,6 +267,7 @@ const void *asset_get_data2(const char *url, int flags, int *size, int *code)
             return NULL;
         }
         asset->request = request_create(asset->url);
+        request_set_priority(asset->request, asset->priority);
     }
     data = request_get_data(asset->request, size, code);
     if (*code && data && (flags & ASSET_USED_ONCE))
@@ -215,7 +284,7 @@ end:
 static int asset_release_(asset_t *asset)
 {
     if (asset->flags & FREE_DATA) {
-        free(asset->data);
+        free_data(asset);
         asset->data = NULL;
         asset->size = 0;
     }
@@ -263,19 +332,35 @@ void asset_release(const char *url)
     asset_release_(asset);
 }
 
+void asset_set_priority(const char *url, double priority)
+{
+    asset_t *asset;
+    asset = asset_get(url, 0);
+    if (!asset) return;
+    asset->priority = priority;
+    if (asset->request) request_set_priority(asset->request, priority);
+}
+
 /*
  * Function: asset_set_hook
- * Set a global function to handle special urls.
+ * Add a global function to handle special urls.
  *
- * The hook function will be called for each new requests, and will bypass
- * the normal query, except if the return code is set to -1.
+ * The hook functions will be called for each new requests, in the order
+ * they were added, and will bypass the normal query, except if the return
+ * code is set to -1.  The urls not handled by any hook then go to the local
+ * files or the network.
  */
 void asset_set_hook(void *user,
         void *(*fn)(void *user, const char *url, int *size, int *code))
 {
-    assert(!g_hook.fn);
-    g_hook.user = user;
-    g_hook.fn = fn;
+    int i;
+    for (i = 0; i < MAX_HOOKS && g_hooks[i].fn; i++) {}
+    if (i == MAX_HOOKS) {
+        LOG_E("Too many assets hooks");
+        return;
+    }
+    g_hooks[i].user = user;
+    g_hooks[i].fn = fn;
 }
 
 
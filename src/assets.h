@@ -18,7 +18,8 @@
  * All assets are uniquely identified by a url, that can be either:
  * - A url to an online resource (https://something).
  * - A bundled data url (asset://something).
- * - A local filesytem path (/path/to/something).
+ * - A local filesytem path (/path/to/something), or a file:// url.  Local
+ *   files are memory mapped when possible.
  *
  * The function <asset_get_data> return the data associated with an url
  * if available, and the function <asset_release> is a hint to the assets
@@ -85,6 +86,16 @@ const void *asset_get_data2(const char *url, int flags, int *size, int *code);
  */
 void asset_release(const char *url);
 
+/*
+ * Function: asset_set_priority
+ * Set the download priority of an online asset.
+ *
+ * When too many requests are running at the same time, the ones with the
+ * lowest priority values are started first.  Can be called before the
+ * first call to asset_get_data.
+ */
+void asset_set_priority(const char *url, double priority);
+
 /*
  * Macro: ASSET_ITER
  * Iter all the asset url that start with a given prefix.
@@ -112,10 +123,12 @@ void asset_register(const char *url, const void *data, int size,
 
 /*
  * Function: asset_set_hook
- * Set a global function to handle special urls.
+ * Add a global function to handle special urls.
  *
- * The hook function will be called for each new requests, and will bypass
- * the normal query, except if the return code is set to -1.
+ * The hook functions will be called for each new requests, in the order
+ * they were added, and will bypass the normal query, except if the return
+ * code is set to -1.  The urls not handled by any hook then go to the local
+ * files or the network.
  */
 void asset_set_hook(void *user,
         void *(*fn)(void *user, const char *url, int *size, int *code));
@@ -30,7 +30,7 @@ extern "C" {
 #define STBI_ONLY_PNG
 
 #ifndef SWE_GUI
-#   ifdef __EMSCRIPTEN__
+#   if defined(__EMSCRIPTEN__) || defined(RENDER_HEADLESS)
 #      define SWE_GUI 0
 #   else
 #      define SWE_GUI 1
@@ -52,6 +52,11 @@ extern "C" {
 #   define snprintf stbsp_snprintf
 #endif
 
+// Use a real thread pool for the workers on native unix builds.
+#if !defined(HAVE_PTHREAD) && !defined(__EMSCRIPTEN__) && defined(__unix__)
+#   define HAVE_PTHREAD 1
+#endif
+
 // Ini config.
 #define INI_MAX_LINE 512
 
@@ -24,6 +24,36 @@ static void core_on_fov_changed(obj_t *obj, const attribute_t *attr)
     core->fov = clamp(core->fov, CORE_MIN_FOV, proj.klass->max_fov);
 }
 
+static void core_on_memory_budget_changed(obj_t *obj,
+                                          const attribute_t *attr)
+{
+    if (core->memory_budget < 0) core->memory_budget = 0;
+    cache_set_budget((int64_t)core->memory_budget * (1 << 20));
+}
+
+static void core_on_worker_threads_changed(obj_t *obj,
+                                           const attribute_t *attr)
+{
+    if (core->worker_threads < 0) core->worker_threads = 0;
+    worker_pool_release();
+    worker_pool_init(core->worker_threads);
+}
+
+static void add_memory_usage(void *user, const char *name, int64_t size)
+{
+    json_value *subsystems = user;
+    json_value *value;
+    int i;
+    // Several caches can share the same name.
+    for (i = 0; i < subsystems->u.object.length; i++) {
+        if (strcmp(subsystems->u.object.values[i].name, name) != 0) continue;
+        value = subsystems->u.object.values[i].value;
+        value->u.integer += size;
+        return;
+    }
+    json_object_push(subsystems, name, json_integer_new(size));
+}
+
 static void add_progressbar(void *user, const char *id, const char *label,
                             int v, int total,
                             int error, const char *error_msg)
@@ -50,6 +80,74 @@ static json_value *core_fn_progressbars(obj_t *obj, const attribute_t *attr,
     return ret;
 }
 
+/*
+ * Return the profiling info of the last frame, for example:
+ *
+ * {
+ *   "update": 0.5, "render": 4.2,
+ *   "modules": {"stars": {"update": 0.0, "render": 1.9}, ...},
+ *   "tiles": {"loaded": 120, "errors": 0, "cache_size": 3145728},
+ *   "render_items": {"items": 80, "points": 5000, ...}
+ * }
+ *
+ * All the times are in ms.  The value is only computed when requested, we
+ * don't emit any change signal for it.
+ */
+static json_value *core_fn_stats(obj_t *obj, const attribute_t *attr,
+                                 const json_value *args)
+{
+    int i, nb_loaded, nb_errors, cache_size;
+    json_value *ret, *modules, *mod, *tiles, *items, *memory, *subsystems;
+    int64_t usage;
+    const module_stats_t *stats;
+    render_stats_t rstats = {};
+
+    ret = json_object_new(0);
+    json_object_push(ret, "update", json_double_new(core->update_time * 1000));
+    json_object_push(ret, "render", json_double_new(core->render_time * 1000));
+
+    modules = json_object_push(ret, "modules", json_object_new(0));
+    for (i = 0; i < core->nb_modules; i++) {
+        stats = &core->modules_stats[i];
+        if (!stats->module->id) continue;
+        mod = json_object_push(modules, stats->module->id,
+                               json_object_new(0));
+        json_object_push(mod, "update",
+                         json_double_new(stats->update_time * 1000));
+        json_object_push(mod, "render",
+                         json_double_new(stats->render_time * 1000));
+    }
+
+    hips_get_global_stats(&nb_loaded, &nb_errors, &cache_size);
+    tiles = json_object_push(ret, "tiles", json_object_new(0));
+    json_object_push(tiles, "loaded", json_integer_new(nb_loaded));
+    json_object_push(tiles, "errors", json_integer_new(nb_errors));
+    json_object_push(tiles, "cache_size", json_integer_new(cache_size));
+
+    memory = json_object_push(ret, "memory", json_object_new(0));
+    json_object_push(memory, "budget",
+                     json_integer_new((int64_t)core->memory_budget << 20));
+    subsystems = json_object_new(0);
+    usage = cache_get_memory_usage(subsystems, add_memory_usage);
+    json_object_push(memory, "usage", json_integer_new(usage));
+    json_object_push(memory, "subsystems", subsystems);
+
+    if (core->rend) render_get_stats(core->rend, &rstats);
+    items = json_object_push(ret, "render_items", json_object_new(0));
+    json_object_push(items, "items", json_integer_new(rstats.nb_items));
+    json_object_push(items, "draws", json_integer_new(rstats.nb_draws));
+    json_object_push(items, "points", json_integer_new(rstats.nb_points));
+    json_object_push(items, "quads", json_integer_new(rstats.nb_quads));
+    json_object_push(items, "lines", json_integer_new(rstats.nb_lines));
+    json_object_push(items, "meshes", json_integer_new(rstats.nb_meshes));
+    json_object_push(items, "texts", json_integer_new(rstats.nb_texts));
+    json_object_push(items, "textures",
+                     json_integer_new(rstats.nb_textures));
+    json_object_push(items, "vg", json_integer_new(rstats.nb_vg));
+    json_object_push(items, "models", json_integer_new(rstats.nb_models));
+    return ret;
+}
+
 EMSCRIPTEN_KEEPALIVE
 obj_t *core_get_module(const char *id)
 {
@@ -85,6 +183,37 @@ obj_t *core_get_module(const char *id)
     return ret;
 }
 
+// Return the profiling info of a module, adding it if needed (layers can
+// be added to the core at any time).
+static module_stats_t *get_module_stats(const obj_t *module)
+{
+    int i;
+    module_stats_t *ret;
+    for (i = 0; i < core->nb_modules; i++) {
+        if (core->modules_stats[i].module == module)
+            return &core->modules_stats[i];
+    }
+    core->modules_stats = realloc(core->modules_stats,
+            (core->nb_modules + 1) * sizeof(*core->modules_stats));
+    ret = &core->modules_stats[core->nb_modules++];
+    memset(ret, 0, sizeof(*ret));
+    ret->module = module;
+    return ret;
+}
+
+void core_on_module_removed(const obj_t *module)
+{
+    int i;
+    for (i = 0; i < core->nb_modules; i++) {
+        if (core->modules_stats[i].module != module) continue;
+        memmove(&core->modules_stats[i], &core->modules_stats[i + 1],
+                (core->nb_modules - i - 1) * sizeof(*core->modules_stats));
+        core->nb_modules--;
+        break;
+    }
+    query_on_module_removed(module);
+}
+
 static int modules_sort_cmp(void *a, void *b)
 {
     obj_t *at, *bt;
@@ -257,6 +386,9 @@ void core_init(double win_w, double win_h, double pixel_scale)
 void core_release(void)
 {
     obj_t *module;
+    // Make sure no tile is still being loaded before deleting the modules.
+    worker_pool_release();
+    query_release();
     DL_FOREACH(core->obj.children, module) {
         if (module->klass->del) module->klass->del(module);
     }
@@ -286,7 +418,7 @@ EMSCRIPTEN_KEEPALIVE
 int core_update(void)
 {
     bool atm_visible;
-    double lwmax, now, dt;
+    double lwmax, now, dt, t;
     int r;
     obj_t *atm, *module;
     task_t *task, *task_tmp;
@@ -338,11 +470,14 @@ int core_update(void)
     DL_SORT(core->obj.children, modules_sort_cmp);
     DL_FOREACH(core->obj.children, module) {
         if (module->klass->update) {
+            t = sys_get_unix_time();
             r = module->klass->update(module, dt);
             if (r < 0) LOG_E("Error updating module '%s'", module->id);
+            get_module_stats(module)->update_time = sys_get_unix_time() - t;
         }
     }
 
+    core->update_time = sys_get_unix_time() - now;
     return 0;
 }
 
@@ -522,7 +657,7 @@ int core_render(double win_w, double win_h, double pixel_scale)
 {
     obj_t *module;
     projection_t proj;
-    double max_vmag, hints_vmag;
+    double max_vmag, hints_vmag, t, start_time;
 
     // Used to make sure some values are not touched during render.
     struct {
@@ -534,6 +669,7 @@ int core_render(double win_w, double win_h, double pixel_scale)
     };
     (void)bck;
 
+    start_time = sys_get_unix_time();
     core->win_size[0] = win_w;
     core->win_size[1] = win_h;
     core->win_pixels_scale = pixel_scale;
@@ -570,7 +706,9 @@ int core_render(double win_w, double win_h, double pixel_scale)
     paint_prepare(&painter, win_w, win_h, pixel_scale);
 
     DL_FOREACH(core->obj.children, module) {
+        t = sys_get_unix_time();
         obj_render(module, &painter);
+        get_module_stats(module)->render_time = sys_get_unix_time() - t;
     }
 
     // Render the viewport cap for debugging.
@@ -583,6 +721,9 @@ int core_render(double win_w, double win_h, double pixel_scale)
         render_proj_markers(&painter);
     }
 
+    // Start the tiles downloads requested during this frame.
+    hips_schedule_fetches(&painter);
+
     // Flush all rendering pipeline
     paint_finish(&painter);
 
@@ -597,6 +738,7 @@ int core_render(double win_w, double win_h, double pixel_scale)
             module->klass->post_render(module, &painter);
     }
 
+    core->render_time = sys_get_unix_time() - start_time;
     return 0;
 }
 
@@ -1001,6 +1143,10 @@ EMSCRIPTEN_KEEPALIVE
 obj_t *core_search(const char *query)
 {
     obj_t *module, *ret = NULL;
+
+    ret = search_index_get(query);
+    if (ret) return ret;
+    // Not indexed (or its tile is not loaded anymore): iter all the objects.
     DL_FOREACH(core->obj.children, module) {
         module_list_objs(module, NAN, 0, NULL, USER_PASS((void*)query, &ret),
                          on_search);
@@ -1008,6 +1154,26 @@ obj_t *core_search(const char *query)
     return ret;
 }
 
+static void on_complete(void *user, const char *dsgn)
+{
+    json_value *ret = user;
+    json_array_push(ret, json_string_new(dsgn));
+}
+
+EMSCRIPTEN_KEEPALIVE
+char *core_search_complete(const char *prefix, int max)
+{
+    json_value *ret;
+    char *str;
+
+    ret = json_array_new(0);
+    search_index_complete(prefix, max, ret, on_complete);
+    str = malloc(json_measure(ret));
+    json_serialize(str, ret);
+    json_builder_free(ret);
+    return str;
+}
+
 static obj_klass_t core_klass = {
     .id = "core",
     .size = sizeof(core_t),
@@ -1020,8 +1186,13 @@ static obj_klass_t core_klass = {
         PROPERTY(selection, TYPE_OBJ, MEMBER(core_t, selection)),
         PROPERTY(lock, TYPE_OBJ, MEMBER(core_t, target.lock)),
         PROPERTY(progressbars, TYPE_JSON, .fn = core_fn_progressbars),
+        PROPERTY(stats, TYPE_JSON, .fn = core_fn_stats),
         PROPERTY(fps, TYPE_INT, MEMBER(core_t, fps.avg)),
         PROPERTY(clicks, TYPE_INT, MEMBER(core_t, clicks)),
+        PROPERTY(memory_budget, TYPE_INT, MEMBER(core_t, memory_budget),
+                 .on_changed = core_on_memory_budget_changed),
+        PROPERTY(worker_threads, TYPE_INT, MEMBER(core_t, worker_threads),
+                 .on_changed = core_on_worker_threads_changed),
         PROPERTY(zoom, TYPE_FLOAT, MEMBER(core_t, zoom)),
         PROPERTY(test, TYPE_BOOL, MEMBER(core_t, test)),
         PROPERTY(exposure_scale, TYPE_FLOAT, MEMBER(core_t, exposure_scale)),
@@ -18,6 +18,8 @@
 #include "observer.h"
 #include "obj.h"
 #include "module.h"
+#include "query.h"
+#include "search_index.h"
 #include "otypes.h"
 #include "telescope.h"
 #include "tonemapper.h"
@@ -34,6 +36,17 @@ extern core_t *core;    // Global core object.
 
 /******* Section: Core ****************************************************/
 
+/*
+ * Type: module_stats_t
+ * Per module profiling info of the last frame.
+ */
+typedef struct module_stats
+{
+    const obj_t *module;
+    double      update_time; // Time spent in the module update (sec).
+    double      render_time; // Time spent in the module render (sec).
+} module_stats_t;
+
 /*
  * Type: task_t
  * Contains info about some extra running tasks.
@@ -102,6 +115,21 @@ struct core
     double          clock; // Real time clock (sec, unix time).
     fps_t           fps; // FPS counter.
 
+    // Profiling of the last frame, exposed in the 'stats' attribute.
+    double          update_time; // Time spent in core_update (sec).
+    double          render_time; // Time spent in core_render (sec).
+    module_stats_t  *modules_stats;
+    int             nb_modules;
+
+    // Global memory budget of the caches (MB), zero for no limit.  The
+    // memory usage is reported in the 'stats' attribute.
+    int             memory_budget;
+
+    // Number of threads of the workers pool (tiles loading...), zero for
+    // one less than the number of cpus.  Changing it restarts the pool,
+    // after waiting for the queued workers.
+    int             worker_threads;
+
     // Number of clicks so far.  This is just so that we can wait for clicks
     // from the ui.
     int clicks;
@@ -143,6 +171,17 @@ struct core
         int         mode;
     } time_animation;
 
+    // Guess of where the view is going, used to prefetch the tiles.
+    // Updated at each frame in core_update_observer.
+    struct {
+        bool        active;     // Set if the view is moving.
+        double      pos[3];     // Predicted direction in mount frame.
+        double      fov;        // Predicted fov.
+        // Last values and velocities (per sec) of the view.
+        double      yaw, pitch, fov_log;
+        double      v_yaw, v_pitch, v_fov_log;
+    } view_prediction;
+
     double time_speed; // Time update speed factor: 0=stopped, 1=real time.
 
     fader_t refraction; // Toggle the observer refraction.
@@ -264,6 +303,14 @@ obj_t *core_get_obj_at(double x, double y, double max_dist);
  */
 obj_t *core_get_module(const char *id);
 
+/*
+ * Function: core_on_module_removed
+ * Forget all the data we keep about a module removed from the core.
+ *
+ * Called by module_remove, since the module can be deleted right after.
+ */
+void core_on_module_removed(const obj_t *module);
+
 bool core_is_point_occulted(const double pos[3], bool at_inf,
                             const observer_t *obs, const obj_t *ignore);
 
@@ -561,6 +608,23 @@ obj_t *core_get_planet(int horizons_id);
  */
 obj_t *core_search(const char *dsgns);
 
+/*
+ * Function: core_search_complete
+ * List the designations starting with a prefix, for the search completion
+ *
+ * Only the designations of the objects that have been loaded so far are
+ * returned.  See <search_index_complete>.
+ *
+ * Parameters:
+ *   prefix - The beginning of a designation.
+ *   max    - Max number of results.
+ *
+ * Return:
+ *   A newly allocated json array string of the designations, ranked by
+ *   relevance.  The caller should free it.
+ */
+char *core_search_complete(const char *prefix, int max);
+
 // Just for convenience: horizons ids for a few common bodies.
 enum {
     PLANET_SUN = 10,
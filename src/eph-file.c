@@ -36,6 +36,13 @@
  *   4 bytes: version
  *   8 bytes: nuniq hips tile pos
  *
+ * Since version 4, the stars tiles can be split into several STAR or GAIA
+ * chunks, each one sorted by magnitude, and with the chunks themselves
+ * sorted by magnitude, so that we can only decode the faint stars when
+ * needed.  The tile header of those chunks is followed by:
+ *   4 bytes: min vmag of the chunk stars (float)
+ *   4 bytes: max vmag of the chunk stars (float)
+ *
  * Compressed data block:
  *   4 bytes: data size
  *   4 bytes: compressed data size
@@ -77,6 +84,18 @@ int eph_read_tile_header(const void *data, int data_size, int *data_ofs,
     return 0;
 }
 
+int eph_read_mag_range(const void *data, int data_size, int *data_ofs,
+                       double *mag_min, double *mag_max)
+{
+    float v[2];
+    CHECK(*data_ofs + 8 <= data_size);
+    memcpy(v, data + *data_ofs, 8);
+    *mag_min = v[0];
+    *mag_max = v[1];
+    *data_ofs += 8;
+    return 0;
+}
+
 void *eph_read_compressed_block(const void *data, int data_size,
                                 int *data_ofs, int *size)
 {
@@ -207,6 +226,31 @@ double eph_convert_f(int src_unit, int unit, double v)
     return v;
 }
 
+void eph_get_column_view(const void *table, int nb, int flags,
+                         const eph_table_column_t *column,
+                         eph_column_view_t *view)
+{
+    memset(view, 0, sizeof(*view));
+    view->size = column->type == 's' ? column->size :
+                 column->type == 'Q' ? 8 : 4;
+    view->factor = 1.0;
+    if (!column->got) return;
+    assert(column->size >= view->size);
+    if (flags & 1) {
+        // Shuffled data: byte k of all the rows are stored contiguously.
+        view->data = (const uint8_t*)table + column->start * nb;
+        view->stride = 1;
+        view->byte_stride = nb;
+    } else {
+        view->data = (const uint8_t*)table + column->start;
+        view->stride = column->row_size;
+        view->byte_stride = 1;
+    }
+    // All the unit conversions are simple factors.
+    if (column->type == 'f')
+        view->factor = eph_convert_f(column->src_unit, column->unit, 1.0);
+}
+
 int eph_read_table_row(const void *data, int data_size, int *data_ofs,
                        int nb_columns, const eph_table_column_t *columns,
                        ...)
@@ -11,6 +11,7 @@
 #define EPH_FILE_H
 
 #include <stdint.h>
+#include <string.h>
 
 #include "json.h"
 
@@ -31,6 +32,14 @@ int eph_load(const void *data, int data_size, void *user,
 int eph_read_tile_header(const void *data, int data_size, int *data_ofs,
                          int *version, int *order, int *pix);
 
+/*
+ * Function: eph_read_mag_range
+ * Read the magnitude range that follows the tile header of the version 4
+ * stars chunks.
+ */
+int eph_read_mag_range(const void *data, int data_size, int *data_ofs,
+                       double *mag_min, double *mag_max);
+
 void *eph_read_compressed_block(const void *data, int data_size,
                                 int *data_ofs, int *size);
 
@@ -85,4 +94,103 @@ int eph_read_table_row(const void *data, int data_size, int *data_ofs,
                        int nb_columns, const eph_table_column_t *columns,
                        ...);
 
+/*
+ * Type: eph_column_view_t
+ * Direct read access to a column of an uncompressed table.
+ *
+ * Byte k of the value of row i is at: data + i * stride + k * byte_stride.
+ * This works for both the plain and the shuffled table layouts, so we never
+ * have to copy the table data.
+ *
+ * Attributes:
+ *   data        - First byte of the first row, NULL if the column was not
+ *                 in the file.
+ *   stride      - Distance in bytes between two rows.
+ *   byte_stride - Distance in bytes between two bytes of a value.
+ *   size        - Size of a value in bytes.
+ *   factor      - For float columns, factor to apply to get the value in
+ *                 the requested unit.
+ */
+typedef struct eph_column_view {
+    const uint8_t *data;
+    int         stride;
+    int         byte_stride;
+    int         size;
+    double      factor;
+} eph_column_view_t;
+
+/*
+ * Function: eph_get_column_view
+ * Get a view into a column of a table, as returned by
+ * eph_read_compressed_block.
+ *
+ * Parameters:
+ *   table  - The uncompressed table data.
+ *   nb     - Number of rows in the table.
+ *   flags  - Table flags as returned by eph_read_table_header.
+ *   column - A column filled by eph_read_table_header.
+ *   view   - Receive the view.
+ */
+void eph_get_column_view(const void *table, int nb, int flags,
+                         const eph_table_column_t *column,
+                         eph_column_view_t *view);
+
+// Copy the raw bytes of a value from a column view.
+static inline void eph_column_read(const eph_column_view_t *view, int row,
+                                   void *out)
+{
+    int k;
+    const uint8_t *src = view->data + row * view->stride;
+    if (view->byte_stride == 1) {
+        memcpy(out, src, view->size);
+        return;
+    }
+    for (k = 0; k < view->size; k++)
+        ((uint8_t*)out)[k] = src[k * view->byte_stride];
+}
+
+/*
+ * Functions to read a single value from a column view.
+ *
+ * Missing columns return zero (or an empty string), as eph_read_table_row
+ * does.  For the string getter, out must be at least view->size + 1 bytes
+ * long.
+ */
+
+static inline double eph_column_get_f(const eph_column_view_t *view, int row)
+{
+    float v;
+    if (!view->data) return 0;
+    eph_column_read(view, row, &v);
+    return (float)(v * view->factor);
+}
+
+static inline int eph_column_get_i(const eph_column_view_t *view, int row)
+{
+    int32_t v;
+    if (!view->data) return 0;
+    eph_column_read(view, row, &v);
+    return v;
+}
+
+static inline uint64_t eph_column_get_q(const eph_column_view_t *view,
+                                        int row)
+{
+    uint64_t v;
+    if (!view->data) return 0;
+    eph_column_read(view, row, &v);
+    return v;
+}
+
+static inline void eph_column_get_s(const eph_column_view_t *view, int row,
+                                    char *out)
+{
+    if (!view->data) {
+        out[0] = '\0';
+        return;
+    }
+    eph_column_read(view, row, out);
+    out[view->size] = '\0';
+}
+
 #endif // EPH_FILE_H
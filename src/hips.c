@@ -9,7 +9,11 @@
 
 #include "swe.h"
 #include "ini.h"
+#include <dirent.h>
+#include <errno.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h> // For crc32.
 
 // Should be good enough...
@@ -54,6 +58,10 @@ struct tile {
         void *data;
         int size;
         int cost;
+        bool owns_data; // Set if data has to be freed.
+        char *asset;    // Url of the asset data to release once done.
+        bool from_disk; // Data comes from the decoded tiles disk cache.
+        bool saved;     // Tile added to the decoded tiles disk cache.
     } *loader;
 };
 
@@ -77,9 +85,85 @@ typedef struct {
     texture_t   *tex;
 } img_tile_t;
 
+// Max number of tiles downloads we start per frame.
+#define MAX_FETCHES_PER_FRAME 8
+
+// Max number of tiles downloads running at the same time.
+#define MAX_RUNNING_FETCHES 16
+
+// Number of frames after which we cancel a running download if the tile
+// is not asked for anymore.
+#define FETCH_TIMEOUT 60
+
+// Added to the priority of the prefetched tiles, so that they always come
+// after the visible ones.
+#define PREFETCH_BIAS 16
+
+// Max number of tiles we look at per prefetch call.
+#define MAX_PREFETCH_TILES 64
+
 // Gobal cache for all the tiles.
 static cache_t *g_cache = NULL;
 
+/*
+ * Type: fetch_t
+ * A tile download, queued or running, in the fetch scheduler.
+ */
+typedef struct fetch fetch_t;
+struct fetch {
+    UT_hash_handle  hh;
+    tile_key_t      key;
+    hips_t          *hips;
+    int             order;
+    int             pix;
+    char            *url;
+    bool            running;
+    bool            prefetch;   // Only asked for by hips_prefetch.
+    uint64_t        last_frame; // Last frame the tile was asked for.
+    double          priority;   // Lower first.
+};
+
+// Global fetch scheduler.
+static struct {
+    fetch_t     *fetches; // Hash table of all the queued and running fetches.
+    int         nb_running;
+    uint64_t    frame;
+} g_fetches = {};
+
+// Number of tiles loaded and failed so far, for the stats.
+static int g_nb_loaded = 0;
+static int g_nb_errors = 0;
+
+/*
+ * Decoded tiles disk cache.
+ *
+ * Each tile is stored in a file <dir>/<hips hash>/<nuniq>.tile, with a
+ * fixed header followed by the data returned by the save_tile setting:
+ *
+ *   4 bytes: magic string "SWTC"
+ *   4 bytes: format version (DISK_CACHE_VERSION)
+ *   4 bytes: survey data version (settings.cache_version)
+ *   4 bytes: children transparency mask
+ *   8 bytes: survey release date
+ *   4 bytes: data size
+ *   4 bytes: padding
+ *
+ * We keep in memory the set of all the tiles present in the directory, so
+ * that the missing tiles don't cost any file system access.
+ */
+#define DISK_CACHE_VERSION 1
+#define DISK_CACHE_HEADER_SIZE 32
+
+typedef struct {
+    UT_hash_handle  hh;
+    tile_key_t      key; // Order -1 means the survey directory was scanned.
+} disk_tile_t;
+
+static struct {
+    char        *dir;
+    disk_tile_t *tiles;
+} g_disk_cache = {};
+
 
 static void *create_img_tile(
         void *user, int order, int pix, const void *src, int size,
@@ -105,6 +189,10 @@ hips_t *hips_create(const char *url, double release_date,
     hips->release_date = release_date;
     hips->frame = FRAME_ASTROM;
     hips->hash = crc32(0, (const void*)url, strlen(url));
+    if (hips_archive_is_archive(url)) {
+        hips->archive = hips_archive_open(url);
+        if (!hips->archive) hips->error = -1;
+    }
     return hips;
 }
 
@@ -120,6 +208,7 @@ void hips_delete(hips_t *hips)
     for (i = 0; i < 12; i++)
         texture_release(hips->allsky.textures[i]);
     json_builder_free(hips->properties);
+    hips_archive_close(hips->archive);
     free(hips);
 }
 
@@ -210,6 +299,18 @@ static int parse_properties(hips_t *hips)
     const char *data;
     char url[URL_MAX_SIZE];
     int code;
+
+    if (hips->archive) {
+        data = hips_archive_get_file(hips->archive, "properties", NULL);
+        if (!data) {
+            LOG_E("No properties file in hips archive %s", hips->url);
+            return -1;
+        }
+        hips->properties = json_object_new(0);
+        ini_parse_string(data, property_handler, hips);
+        return 0;
+    }
+
     get_url_for(hips, url, sizeof(url), "properties");
     data = asset_get_data2(url, ASSET_USED_ONCE, NULL, &code);
     if (!data && code) {
@@ -223,17 +324,30 @@ static int parse_properties(hips_t *hips)
 }
 
 
+// Release the tile loader and its data.
+static void loader_delete(tile_t *tile)
+{
+    if (tile->loader->owns_data) free(tile->loader->data);
+    if (tile->loader->asset) {
+        asset_release(tile->loader->asset);
+        free(tile->loader->asset);
+    }
+    free(tile->loader);
+    tile->loader = NULL;
+}
+
 // Used by the cache.
 static int del_tile(void *data)
 {
     tile_t *tile = data;
-    // XXX: why the worker_is_running?
+    // Can't delete the tile while it is queued or loaded in a thread.
     if (tile->loader && worker_is_running(&tile->loader->worker))
         return CACHE_KEEP;
     if (tile->data) {
         if (tile->hips->settings.delete_tile(tile->data) == CACHE_KEEP)
             return CACHE_KEEP;
     }
+    if (tile->loader) loader_delete(tile);
     hips_delete(tile->hips);
     free(tile);
     return 0;
@@ -472,8 +586,9 @@ static int render_visitor(hips_t *hips, const painter_t *painter_,
 int hips_render(hips_t *hips, const painter_t *painter,
                 const double transf[4][4], int split_order)
 {
-    int nb_tot = 0, nb_loaded = 0;
+    int nb_tot = 0, nb_loaded = 0, nb = -1, i;
     int render_order, order, pix, split;
+    const int *visible = NULL;
     hips_iterator_t iter;
     uv_map_t map;
 
@@ -489,6 +604,19 @@ int hips_render(hips_t *hips, const painter_t *painter,
     // Can't split less than the rendering order.
     split_order = fmax(split_order, render_order);
 
+    // Without transformation, we can directly use the visible cells
+    // computed by the painter.
+    if (!transf) {
+        nb = painter_get_visible_healpix(painter, hips->frame, render_order,
+                                         &visible);
+    }
+    split = 1 << (split_order - render_order);
+    for (i = 0; i < nb; i++) {
+        render_visitor(hips, painter, transf, render_order, visible[i], split,
+                       &nb_tot, &nb_loaded);
+    }
+    if (nb >= 0) goto end;
+
     // Breath first traversal of all the tiles.
     hips_iter_init(&iter);
     while (hips_iter_next(&iter, &order, &pix)) {
@@ -501,11 +629,11 @@ int hips_render(hips_t *hips, const painter_t *painter,
             hips_iter_push_children(&iter, order, pix);
             continue;
         }
-        split = 1 << (split_order - render_order);
         render_visitor(hips, painter, transf, order, pix, split,
                        &nb_tot, &nb_loaded);
     }
 
+end:
     progressbar_report(hips->url, hips->label, nb_loaded, nb_tot, -1);
     return 0;
 }
@@ -560,11 +688,17 @@ bool hips_update(hips_t *hips)
     if (!hips->allsky.worker.fn &&
             !hips->allsky.not_available && !hips->allsky.data &&
             hips->order_min == 0) {
-        snprintf(url, sizeof(url), "%s/Norder%d/Allsky.%s?v=%d",
-                 hips->service_url, hips->order_min, hips->ext,
-                 (int)hips->release_date);
-        data = asset_get_data2(url, ASSET_USED_ONCE, &size, &code);
-        if (!code) return false;
+        if (hips->archive) {
+            snprintf(url, sizeof(url), "Norder%d/Allsky.%s",
+                     hips->order_min, hips->ext);
+            data = hips_archive_get_file(hips->archive, url, &size);
+        } else {
+            snprintf(url, sizeof(url), "%s/Norder%d/Allsky.%s?v=%d",
+                     hips->service_url, hips->order_min, hips->ext,
+                     (int)hips->release_date);
+            data = asset_get_data2(url, ASSET_USED_ONCE, &size, &code);
+            if (!code) return false;
+        }
         if (!data) hips->allsky.not_available = true;
         if (data) {
             worker_init(&hips->allsky.worker, load_allsky_worker);
@@ -642,26 +776,405 @@ int hips_get_render_order_planet(const hips_t *hips, const painter_t *painter,
     return ceil(order + 1);
 }
 
+static bool disk_cache_enabled(const hips_t *hips)
+{
+    return g_disk_cache.dir && hips->settings.save_tile &&
+           hips->settings.load_tile;
+}
+
+static void disk_cache_get_path(const hips_t *hips, int order, int pix,
+                                char *buf, int len)
+{
+    snprintf(buf, len, "%s/%08x/%" PRIu64 ".tile", g_disk_cache.dir,
+             hips->hash, (uint64_t)pix + 4 * (1ULL << (2 * order)));
+}
+
+static disk_tile_t *disk_cache_find(const hips_t *hips, int order, int pix)
+{
+    disk_tile_t *entry;
+    tile_key_t key = {hips->hash, order, pix};
+    HASH_FIND(hh, g_disk_cache.tiles, &key, sizeof(key), entry);
+    return entry;
+}
+
+static void disk_cache_add(const hips_t *hips, int order, int pix)
+{
+    disk_tile_t *entry;
+    if (disk_cache_find(hips, order, pix)) return;
+    entry = calloc(1, sizeof(*entry));
+    entry->key = (tile_key_t){hips->hash, order, pix};
+    HASH_ADD(hh, g_disk_cache.tiles, key, sizeof(entry->key), entry);
+}
+
+// List the tiles already in the cache directory of a survey.
+static void disk_cache_scan(const hips_t *hips)
+{
+    char path[1024];
+    DIR *dir;
+    struct dirent *dirent;
+    uint64_t nuniq;
+    int order, pix, len;
+
+    if (disk_cache_find(hips, -1, 0)) return; // Already done.
+    disk_cache_add(hips, -1, 0);
+    snprintf(path, sizeof(path), "%s/%08x", g_disk_cache.dir, hips->hash);
+    dir = opendir(path);
+    if (!dir) return;
+    while ((dirent = readdir(dir))) {
+        // Skip anything else, including the temporary files.
+        len = 0;
+        sscanf(dirent->d_name, "%" SCNu64 ".tile%n", &nuniq, &len);
+        if (!len || dirent->d_name[len] || nuniq < 4) continue;
+        order = log2(nuniq / 4) / 2;
+        pix = nuniq - 4 * (1ULL << (2 * order));
+        disk_cache_add(hips, order, pix);
+    }
+    closedir(dir);
+}
+
+static void disk_cache_remove(const hips_t *hips, int order, int pix)
+{
+    char path[1024];
+    disk_tile_t *entry = disk_cache_find(hips, order, pix);
+    if (!entry) return;
+    HASH_DEL(g_disk_cache.tiles, entry);
+    free(entry);
+    disk_cache_get_path(hips, order, pix, path, sizeof(path));
+    remove(path);
+}
+
+/*
+ * Read a tile from the disk cache.
+ *
+ * Return the malloced file data, or NULL if the tile is not in the cache
+ * or is not valid anymore.
+ */
+static void *disk_cache_read(const hips_t *hips, int order, int pix,
+                             int *size)
+{
+    char path[1024];
+    uint8_t *data;
+    int version, cache_version, data_size;
+    double release_date;
+
+    disk_cache_scan(hips);
+    if (!disk_cache_find(hips, order, pix)) return NULL;
+    disk_cache_get_path(hips, order, pix, path, sizeof(path));
+    data = read_file(path, size);
+    if (!data) goto error;
+    if (*size < DISK_CACHE_HEADER_SIZE) goto error;
+    memcpy(&version, data + 4, 4);
+    memcpy(&cache_version, data + 8, 4);
+    memcpy(&release_date, data + 16, 8);
+    memcpy(&data_size, data + 24, 4);
+    if (    memcmp(data, "SWTC", 4) != 0 ||
+            version != DISK_CACHE_VERSION ||
+            cache_version != hips->settings.cache_version ||
+            release_date != hips->release_date ||
+            data_size != *size - DISK_CACHE_HEADER_SIZE)
+        goto error;
+    return data;
+
+error:
+    // The file is gone or outdated: remove it and get the tile again.
+    free(data);
+    disk_cache_remove(hips, order, pix);
+    return NULL;
+}
+
+/*
+ * Save a tile to the disk cache.
+ *
+ * Can be called from a loader thread, so we don't touch the tiles set
+ * here.  The file is written under a temporary name first, so that the
+ * other processes never see a partial file.
+ */
+static bool disk_cache_write(const hips_t *hips, int order, int pix,
+                             const void *tile_data, int transparency)
+{
+    char path[1024], tmp_path[1100];
+    uint8_t header[DISK_CACHE_HEADER_SIZE] = "SWTC";
+    const int version = DISK_CACHE_VERSION;
+    void *data;
+    int size;
+    FILE *file;
+    bool ok;
+
+    data = hips->settings.save_tile(hips->settings.user, tile_data, &size);
+    if (!data) return false;
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &hips->settings.cache_version, 4);
+    memcpy(header + 12, &transparency, 4);
+    memcpy(header + 16, &hips->release_date, 8);
+    memcpy(header + 24, &size, 4);
+
+    snprintf(path, sizeof(path), "%s/%08x", g_disk_cache.dir, hips->hash);
+    if (mkdir(path, S_IRWXU) != 0 && errno != EEXIST) {
+        free(data);
+        return false;
+    }
+    disk_cache_get_path(hips, order, pix, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.%p", path, (int)getpid(),
+             tile_data);
+    file = fopen(tmp_path, "wb");
+    if (!file) {
+        free(data);
+        return false;
+    }
+    ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+         (size == 0 || fwrite(data, size, 1, file) == 1);
+    ok = (fclose(file) == 0) && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) remove(tmp_path);
+    free(data);
+    return ok;
+}
+
+void hips_set_tile_cache_dir(const char *dir)
+{
+    disk_tile_t *entry, *tmp;
+    HASH_ITER(hh, g_disk_cache.tiles, entry, tmp) {
+        HASH_DEL(g_disk_cache.tiles, entry);
+        free(entry);
+    }
+    free(g_disk_cache.dir);
+    g_disk_cache.dir = (dir && *dir) ? strdup(dir) : NULL;
+    if (g_disk_cache.dir && mkdir(dir, S_IRWXU) != 0 && errno != EEXIST)
+        LOG_W("Cannot create tiles cache dir '%s'", dir);
+}
+
 static int load_tile_worker(worker_t *worker)
 {
     int transparency = 0;
     typeof(((tile_t*)0)->loader) loader = (void*)worker;
     tile_t *tile = loader->tile;
     hips_t *hips = tile->hips;
-    tile->data = hips->settings.create_tile(
-                    hips->settings.user, tile->pos.order, tile->pos.pix,
-                    loader->data, loader->size, &loader->cost, &transparency);
+    const uint8_t *data = loader->data;
+
+    if (loader->from_disk) {
+        memcpy(&transparency, data + 12, 4);
+        tile->data = hips->settings.load_tile(
+                hips->settings.user, tile->pos.order, tile->pos.pix,
+                data + DISK_CACHE_HEADER_SIZE,
+                loader->size - DISK_CACHE_HEADER_SIZE, &loader->cost);
+    } else {
+        tile->data = hips->settings.create_tile(
+                hips->settings.user, tile->pos.order, tile->pos.pix,
+                data, loader->size, &loader->cost, &transparency);
+        if (tile->data && disk_cache_enabled(hips)) {
+            loader->saved = disk_cache_write(hips, tile->pos.order,
+                                             tile->pos.pix, tile->data,
+                                             transparency);
+        }
+    }
     if (!tile->data) tile->flags |= TILE_LOAD_ERROR;
     tile->flags |= (transparency * TILE_NO_CHILD_0);
-    free(loader->data);
     return 0;
 }
 
+// Finish the loading of a tile, once its loader is done.
+static void tile_loader_done(tile_t *tile, const tile_key_t *key)
+{
+    cache_set_cost(g_cache, key, sizeof(*key),
+                   sizeof(*tile) + tile->loader->cost);
+    if (tile->loader->saved)
+        disk_cache_add(tile->hips, tile->pos.order, tile->pos.pix);
+    // A cached tile we cannot load anymore: just remove it.
+    if (tile->loader->from_disk && (tile->flags & TILE_LOAD_ERROR))
+        disk_cache_remove(tile->hips, tile->pos.order, tile->pos.pix);
+    if (tile->flags & TILE_LOAD_ERROR) g_nb_errors++;
+    else g_nb_loaded++;
+    loader_delete(tile);
+}
+
+// Origin of the data passed to tile_create.
+enum {
+    TILE_SRC_ASSET,     // Assets data, valid until we release the asset.
+    TILE_SRC_DISK,      // Malloced decoded tiles disk cache file data.
+    TILE_SRC_ARCHIVE,   // Survey archive data, valid as long as the survey.
+};
+
+/*
+ * Create a new tile and add it to the cache.
+ *
+ * Parameters:
+ *   data      - The tile data.  We take ownership of the disk cache data.
+ *   src       - One of the TILE_SRC values.
+ *   url       - For TILE_SRC_ASSET, the asset url.  The asset is released
+ *               once the tile is loaded.
+ *
+ * Return the tile if it has been loaded immediately, otherwise NULL, with
+ * code set to zero.
+ */
+static tile_t *tile_create(hips_t *hips, const tile_key_t *key, int flags,
+                           const void *data, int size, int src,
+                           const char *url, int *code)
+{
+    tile_t *tile = calloc(1, sizeof(*tile));
+    tile->pos.order = key->order;
+    tile->pos.pix = key->pix;
+    tile->hips = hips;
+    hips->ref++;
+    cache_add(g_cache, key, sizeof(*key), tile, sizeof(*tile), del_tile);
+
+    tile->loader = calloc(1, sizeof(*tile->loader));
+    worker_init(&tile->loader->worker, load_tile_worker);
+    tile->loader->tile = tile;
+    tile->loader->data = (void*)data;
+    tile->loader->size = size;
+    tile->loader->from_disk = (src == TILE_SRC_DISK);
+    tile->loader->owns_data = (src == TILE_SRC_DISK);
+    // Keep the asset until the loader is done, so that the worker can use
+    // the data directly (mapped local files are then only read there).
+    if (src == TILE_SRC_ASSET) tile->loader->asset = strdup(url);
+    if (flags & HIPS_LOAD_IN_THREAD) {
+        *code = 0;
+        return NULL;
+    }
+    load_tile_worker(&tile->loader->worker);
+    tile_loader_done(tile, key);
+    return tile;
+}
+
+static void fetch_delete(fetch_t *fetch, bool cancel)
+{
+    HASH_DEL(g_fetches.fetches, fetch);
+    if (fetch->running) g_fetches.nb_running--;
+    if (cancel && fetch->running) asset_release(fetch->url);
+    hips_delete(fetch->hips);
+    free(fetch->url);
+    free(fetch);
+}
+
+/*
+ * Check if we can start or continue the download of a tile.
+ *
+ * If not, the tile is added to the scheduler queue, and will be started by
+ * hips_schedule_fetches if it is still needed.
+ */
+static bool fetch_can_start(hips_t *hips, int order, int pix, int flags,
+                            const tile_key_t *key, const char *url)
+{
+    fetch_t *fetch;
+
+    // Only schedule the network requests.
+    if (!str_startswith(url, "http://") && !str_startswith(url, "https://"))
+        return true;
+
+    HASH_FIND(hh, g_fetches.fetches, key, sizeof(*key), fetch);
+    if (!fetch) {
+        fetch = calloc(1, sizeof(*fetch));
+        fetch->key = *key;
+        fetch->hips = hips;
+        hips->ref++;
+        fetch->order = order;
+        fetch->pix = pix;
+        fetch->url = strdup(url);
+        fetch->prefetch = flags & HIPS_PREFETCH;
+        HASH_ADD(hh, g_fetches.fetches, key, sizeof(fetch->key), fetch);
+    }
+    if (!(flags & HIPS_PREFETCH))
+        fetch->prefetch = false;
+    else if (fetch->last_frame != g_fetches.frame)
+        fetch->prefetch = true;
+    fetch->last_frame = g_fetches.frame;
+    return fetch->running;
+}
+
+// Remove a tile from the scheduler, once its download is finished.
+static void fetch_done(const tile_key_t *key)
+{
+    fetch_t *fetch;
+    HASH_FIND(hh, g_fetches.fetches, key, sizeof(*key), fetch);
+    if (fetch) fetch_delete(fetch, false);
+}
+
+static double fetch_get_priority(const fetch_t *fetch,
+                                 const painter_t *painter)
+{
+    double pos[3], dist = 0;
+    const double fov = fmax(painter->proj->fovy, 1.0 * DD2R);
+    const hips_t *hips = fetch->hips;
+
+    // Angular distance to the view center, relative to the fov.
+    if (!hips->fetch.no_distance) {
+        healpix_pix2vec(1 << fetch->order, fetch->pix, pos);
+        convert_frame(painter->obs, hips->frame, FRAME_VIEW, true, pos, pos);
+        dist = acos(clamp(-pos[2], -1, 1)) / fov;
+    }
+    return fetch->order + 4 * dist + hips->fetch.bias +
+           (fetch->prefetch ? PREFETCH_BIAS : 0);
+}
+
+static int fetch_cmp(const void *a, const void *b)
+{
+    return cmp((*(const fetch_t**)a)->priority,
+               (*(const fetch_t**)b)->priority);
+}
+
+void hips_schedule_fetches(const painter_t *painter)
+{
+    fetch_t *fetch, *tmp, **queue;
+    int i, n = 0, code, budget;
+
+    queue = arena_alloc(painter->arena,
+                        HASH_COUNT(g_fetches.fetches) * sizeof(*queue));
+    HASH_ITER(hh, g_fetches.fetches, fetch, tmp) {
+        if (fetch->running) {
+            // Cancel the downloads of the tiles that left the view.
+            if (g_fetches.frame - fetch->last_frame > FETCH_TIMEOUT) {
+                fetch_delete(fetch, true);
+                continue;
+            }
+            // Keep the requests waiting for a connection sorted.
+            if (fetch->last_frame == g_fetches.frame) {
+                fetch->priority = fetch_get_priority(fetch, painter);
+                asset_set_priority(fetch->url, fetch->priority);
+            }
+            continue;
+        }
+        // Drop the tiles that have not been asked for during this frame.
+        if (fetch->last_frame != g_fetches.frame) {
+            fetch_delete(fetch, false);
+            continue;
+        }
+        fetch->priority = fetch_get_priority(fetch, painter);
+        queue[n++] = fetch;
+    }
+    qsort(queue, n, sizeof(*queue), fetch_cmp);
+
+    budget = MAX_RUNNING_FETCHES - g_fetches.nb_running;
+    budget = fmin(budget, MAX_FETCHES_PER_FRAME);
+    for (i = 0; i < n && i < budget; i++) {
+        fetch = queue[i];
+        fetch->running = true;
+        g_fetches.nb_running++;
+        asset_set_priority(fetch->url, fetch->priority);
+        asset_get_data2(fetch->url, ASSET_ACCEPT_404, NULL, &code);
+    }
+    g_fetches.frame++;
+}
+
+static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
+                              int *code);
+
+// Mark a tile that doesn't exist in its parent tile, so that we won't
+// have to search for it again.
+static void tile_set_missing(hips_t *hips, int order, int pix, int flags)
+{
+    int parent_code;
+    tile_t *parent;
+    if (order <= hips->order_min) return;
+    parent = hips_get_tile_(hips, order - 1, pix / 4, flags, &parent_code);
+    if (parent) parent->flags |= (TILE_NO_CHILD_0 << (pix % 4));
+}
+
 static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
                               int *code)
 {
     const void *data;
-    int size, parent_code, asset_flags, cost = 0, transparency = 0;
+    void *disk_data;
+    int size, parent_code;
     char url[URL_MAX_SIZE];
     tile_t *tile, *parent;
     tile_key_t key = {hips->hash, order, pix};
@@ -669,15 +1182,16 @@ static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
     assert(order >= 0);
     *code = 0;
 
-    if (!g_cache) g_cache = cache_create(CACHE_SIZE, 1);
+    if (!g_cache) {
+        g_cache = cache_create(CACHE_SIZE, 1);
+        cache_set_info(g_cache, "tiles", 1);
+    }
     tile = cache_get(g_cache, &key, sizeof(key));
 
     // Got a tile but it is still loading.
     if (tile && tile->loader) {
         if (!worker_iter(&tile->loader->worker)) return NULL;
-        cache_set_cost(g_cache, &key, sizeof(key), tile->loader->cost);
-        free(tile->loader);
-        tile->loader = NULL;
+        tile_loader_done(tile, &key);
     }
     if (tile) {
         *code = 200;
@@ -704,22 +1218,41 @@ static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
             return NULL;
         }
     }
+    // Try the decoded tiles disk cache first.
+    if (disk_cache_enabled(hips)) {
+        disk_data = disk_cache_read(hips, order, pix, &size);
+        if (disk_data) {
+            fetch_done(&key);
+            *code = 200;
+            return tile_create(hips, &key, flags, disk_data, size,
+                               TILE_SRC_DISK, NULL, code);
+        }
+    }
+
+    // The archives tiles are used directly from the mapped file.
+    if (hips->archive) {
+        data = hips_archive_get_tile(hips->archive, order, pix, &size);
+        if (!data) {
+            *code = 404;
+            tile_set_missing(hips, order, pix, flags);
+            return NULL;
+        }
+        *code = 200;
+        return tile_create(hips, &key, flags, data, size, TILE_SRC_ARCHIVE,
+                           NULL, code);
+    }
+
     get_url_for(hips, url, sizeof(url), "Norder%d/Dir%d/Npix%d.%s",
                 order, (pix / 10000) * 10000, pix, hips->ext);
-    asset_flags = ASSET_ACCEPT_404;
-    if (order > 0 && !(flags & HIPS_NO_DELAY))
-        asset_flags |= ASSET_DELAY;
-    data = asset_get_data2(url, asset_flags, &size, code);
+    if (order > 0 && !(flags & HIPS_NO_DELAY) &&
+            !fetch_can_start(hips, order, pix, flags, &key, url))
+        return NULL;
+    data = asset_get_data2(url, ASSET_ACCEPT_404, &size, code);
     if (!(*code)) return NULL; // Still loading the file.
+    fetch_done(&key);
 
-    // If the tile doesn't exists, mark it in the parent tile so that we
-    // won't have to search for it again.
     if ((*code) / 100 == 4) {
-        if (order > hips->order_min) {
-            parent = hips_get_tile_(hips, order - 1, pix / 4, flags,
-                                    &parent_code);
-            if (parent) parent->flags |= (TILE_NO_CHILD_0 << (pix % 4));
-        }
+        tile_set_missing(hips, order, pix, flags);
         return NULL;
     }
 
@@ -731,36 +1264,51 @@ static tile_t *hips_get_tile_(hips_t *hips, int order, int pix, int flags,
 
     assert(hips->settings.create_tile);
 
-    tile = calloc(1, sizeof(*tile));
-    tile->pos.order = order;
-    tile->pos.pix = pix;
-    tile->hips = hips;
-    hips->ref++;
-    cache_add(g_cache, &key, sizeof(key), tile, sizeof(*tile) + cost,
-              del_tile);
+    tile = tile_create(hips, &key, flags, data, size, TILE_SRC_ASSET, url,
+                       code);
+    if (tile && (tile->flags & TILE_LOAD_ERROR))
+        LOG_W("Cannot parse tile %s", url);
+    return tile;
+}
 
-    if (!(flags & HIPS_LOAD_IN_THREAD)) {
-        tile->data = hips->settings.create_tile(
-                hips->settings.user, order, pix, data, size,
-                &cost, &transparency);
-        tile->flags |= (transparency * TILE_NO_CHILD_0);
-        if (!tile->data) {
-            LOG_W("Cannot parse tile %s", url);
-            tile->flags |= TILE_LOAD_ERROR;
+void hips_prefetch(hips_t *hips, const painter_t *painter,
+                   const double pos[3], double fov)
+{
+    int order, pix, code, max_order, nb = 0;
+    double cap[4], tile_cap[4];
+    const int flags = HIPS_LOAD_IN_THREAD | HIPS_PREFETCH;
+    hips_iterator_t iter;
+
+    if (!hips_is_ready(hips)) return;
+
+    // Order we would render at with the future fov.
+    max_order = hips_get_render_order(hips, painter) +
+                round(log2(painter->proj->fovy / fov));
+    max_order = fmin(max_order, hips->order ?: 9);
+    max_order = fmin(max_order, 9); // Same hard limit as hips_render.
+
+    convert_frame(painter->obs, FRAME_MOUNT, hips->frame, true, pos, cap);
+    cap[3] = cos(fmin(fov, M_PI));
+
+    // Load the tiles top down, the children are only loaded once their
+    // parent is.
+    hips_iter_init(&iter);
+    while (hips_iter_next(&iter, &order, &pix)) {
+        healpix_get_bounding_cap(1 << order, pix, tile_cap);
+        if (!cap_intersects_cap(cap, tile_cap)) continue;
+        if (order >= hips->order_min) {
+            if (nb++ >= MAX_PREFETCH_TILES) break;
+            if (!hips_get_tile_(hips, order, pix, flags, &code)) continue;
         }
-        asset_release(url);
-    } else {
-        tile->loader = calloc(1, sizeof(*tile->loader));
-        worker_init(&tile->loader->worker, load_tile_worker);
-        tile->loader->data = malloc(size);
-        tile->loader->size = size;
-        tile->loader->tile = tile;
-        memcpy(tile->loader->data, data, size);
-        asset_release(url);
-        *code = 0;
-        return NULL;
+        if (order < max_order) hips_iter_push_children(&iter, order, pix);
     }
-    return tile;
+}
+
+void hips_get_global_stats(int *nb_loaded, int *nb_errors, int *cache_size)
+{
+    *nb_loaded = g_nb_loaded;
+    *nb_errors = g_nb_errors;
+    *cache_size = g_cache ? cache_get_current_size(g_cache) : 0;
 }
 
 void *hips_get_tile(hips_t *hips, int order, int pix, int flags, int *code)
@@ -770,6 +1318,12 @@ void *hips_get_tile(hips_t *hips, int order, int pix, int flags, int *code)
     return tile ? tile->data : NULL;
 }
 
+void hips_set_tile_cost(hips_t *hips, int order, int pix, int cost)
+{
+    tile_key_t key = {hips->hash, order, pix};
+    cache_set_cost(g_cache, &key, sizeof(key), sizeof(tile_t) + cost);
+}
+
 /*
  * Default tile support for images surveys
  */
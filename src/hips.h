@@ -10,6 +10,7 @@
 #ifndef HIPS_H
 #define HIPS_H
 
+#include "hips_archive.h"
 #include "painter.h"
 #include "utils/worker.h"
 
@@ -27,10 +28,11 @@ enum {
     HIPS_FORCE_USE_ALLSKY       = 1 << 1,
     HIPS_LOAD_IN_THREAD         = 1 << 2,
     HIPS_CACHED_ONLY            = 1 << 3,
-    // If set in hips_get_tile, do not add a small delay before starting
-    // the downloads.  By default we use a small delay of about one sec
-    // per tile.
+    // If set in hips_get_tile, start the download immediately instead of
+    // going through the fetch scheduler (see <hips_schedule_fetches>).
     HIPS_NO_DELAY               = 1 << 4,
+    // Low priority load of a tile that is not visible yet.
+    HIPS_PREFETCH               = 1 << 5,
 };
 
 /*
@@ -43,6 +45,14 @@ enum {
  *                 can be anything.  This is called every time the survey
  *                 load a tile that is not in the cache.  See note [1]
  *   delete_tile - function used to delete the data returned by create_tile.
+ *   save_tile   - optional function used to serialize a tile for the
+ *                 decoded tiles disk cache (see <hips_set_tile_cache_dir>).
+ *                 Return a malloced buffer.  The data is stored 8 bytes
+ *                 aligned, so it can contain raw arrays.
+ *   load_tile   - function used to create a tile from the data returned
+ *                 by save_tile.  Needed if save_tile is set.
+ *   cache_version - version of the save_tile data.  Change it every time
+ *                 the format changes, to ignore the older cached tiles.
  *   user        - pointer passed to create_tile.
  *
  * Note 1:
@@ -54,6 +64,10 @@ typedef struct hips_settings {
     void *(*create_tile)(void *user, int order, int pix, const void *data,
                                int size, int *cost, int *transparency);
     int (*delete_tile)(void *tile);
+    void *(*save_tile)(void *user, const void *tile, int *size);
+    void *(*load_tile)(void *user, int order, int pix, const void *data,
+                       int size, int *cost);
+    int cache_version;
     const char *ext; // If set, force the files extension.
     void *user;
 } hips_settings_t;
@@ -88,7 +102,17 @@ struct hips {
 
     // The settings as passed in the create function.
     hips_settings_t settings;
+    // Set if the survey is a single file archive.
+    hips_archive_t *archive;
     int ref; // Ref counting of hips survey.
+
+    // Fetch scheduler settings.
+    struct {
+        double  bias; // Added to the tiles priority (lower first).
+        // Set if the tiles are not positioned in the sky (planets
+        // surfaces), so that we don't use the distance to the view center.
+        bool    no_distance;
+    } fetch;
 };
 
 
@@ -97,7 +121,8 @@ struct hips {
  * Create a new hips survey.
  *
  * Parameters:
- *   url          - URL to the root of the survey.
+ *   url          - URL to the root of the survey, or path to a survey
+ *                  archive file (see <hips_archive.h>).
  *   release_date - If known, release date in utc.  Otherwise 0.
  */
 hips_t *hips_create(const char *url, double release_date,
@@ -130,6 +155,73 @@ void hips_delete(hips_t *hips);
  */
 void *hips_get_tile(hips_t *hips, int order, int pix, int flags, int *code);
 
+/*
+ * Function: hips_set_tile_cost
+ * Update the cache cost of a custom tile already loaded.
+ *
+ * For the tiles whose data grows after their creation, like the stars tiles
+ * that are decoded by magnitude chunks.
+ */
+void hips_set_tile_cost(hips_t *hips, int order, int pix, int cost);
+
+/*
+ * Function: hips_schedule_fetches
+ * Start the most important tiles downloads.
+ *
+ * The tiles that need to be downloaded are not requested immediately, but
+ * queued with a priority based on their order, their distance to the view
+ * center and the survey.  This function, called once at the end of each
+ * frame, starts the downloads of the tiles with the best priority, up to a
+ * fixed budget.  The tiles that have not been asked for during the frame
+ * are removed from the queue.
+ *
+ * Parameters:
+ *   painter    - The painter used for the frame.
+ */
+void hips_schedule_fetches(const painter_t *painter);
+
+/*
+ * Function: hips_prefetch
+ * Start loading in advance the tiles around a future view.
+ *
+ * The tiles go through the fetch scheduler with a lower priority than the
+ * rendered ones.  Should be called at each frame as long as the tiles are
+ * needed, typically with the values of core->view_prediction.
+ *
+ * Parameters:
+ *   hips       - A hips survey.
+ *   painter    - The painter used for the current frame.
+ *   pos        - Center of the future view, in mount frame.
+ *   fov        - Fov of the future view (rad).
+ */
+void hips_prefetch(hips_t *hips, const painter_t *painter,
+                   const double pos[3], double fov);
+
+/*
+ * Function: hips_get_global_stats
+ * Get some stats about the tiles of all the surveys.
+ *
+ * Parameters:
+ *   nb_loaded  - Set to the number of tiles loaded so far.
+ *   nb_errors  - Set to the number of tiles that failed to load so far.
+ *   cache_size - Set to the current size of the tiles cache (bytes).
+ */
+void hips_get_global_stats(int *nb_loaded, int *nb_errors, int *cache_size);
+
+/*
+ * Function: hips_set_tile_cache_dir
+ * Enable the decoded tiles disk cache.
+ *
+ * The surveys that implement the save_tile and load_tile settings keep a
+ * copy of their decoded tiles in this directory, so that we don't have to
+ * download and parse them again after they have been removed from the
+ * memory cache, or after a restart.
+ *
+ * Parameters:
+ *   dir - Path to the cache directory, or NULL to disable the cache.
+ */
+void hips_set_tile_cache_dir(const char *dir);
+
 /*
  * Function: hips_is_ready
  * Check if a hips survey is ready to use
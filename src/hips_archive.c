@@ -0,0 +1,235 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "hips_archive.h"
+#include "swe.h"
+
+#ifndef __EMSCRIPTEN__
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+/* The survey archive format is as follow:
+ *
+ * Header (32 bytes):
+ *   4 bytes: magic string "HIPA"
+ *   4 bytes: format version (ARCHIVE_VERSION)
+ *   4 bytes: number of tiles
+ *   4 bytes: number of files
+ *   8 bytes: offset of the tiles index
+ *   8 bytes: offset of the files index
+ *
+ * Tiles index, sorted by nuniq (24 bytes per tile):
+ *   8 bytes: nuniq
+ *   8 bytes: data offset
+ *   8 bytes: data size
+ *
+ * Files index (80 bytes per file):
+ *   64 bytes: null padded path, relative to the survey root
+ *   8 bytes: data offset
+ *   8 bytes: data size
+ *
+ * Then all the data blocks.  Every block is followed by a null byte that is
+ * not counted in its size, so that we can directly parse text files.
+ *
+ * All the values are little endian.  The file is memory mapped, and looking
+ * for a tile is a binary search in the index.
+ */
+
+#define ARCHIVE_VERSION 1
+#define HEADER_SIZE 32
+#define TILE_ENTRY_SIZE 24
+#define FILE_ENTRY_SIZE 80
+#define FILE_NAME_SIZE 64
+
+struct hips_archive {
+    hips_archive_t  *next, *prev; // All the opened archives.
+    char            *path;
+    int             ref;
+    const uint8_t   *data;
+    int64_t         size;
+    bool            mapped; // Set if data is memory mapped.
+    int             nb_tiles;
+    int             nb_files;
+    const uint8_t   *tiles;   // Tiles index.
+    const uint8_t   *files;   // Files index.
+};
+
+static hips_archive_t *g_archives = NULL;
+
+bool hips_archive_is_archive(const char *url)
+{
+    return str_endswith(url, HIPS_ARCHIVE_EXT);
+}
+
+static uint64_t read_u64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static bool map_file(hips_archive_t *archive)
+{
+#ifndef __EMSCRIPTEN__
+    int fd;
+    struct stat st;
+    void *data;
+
+    fd = open(archive->path, O_RDONLY);
+    if (fd == -1) return false;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    archive->data = data;
+    archive->size = st.st_size;
+    archive->mapped = true;
+    return true;
+#else
+    int size;
+    archive->data = read_file(archive->path, &size);
+    archive->size = size;
+    return archive->data != NULL;
+#endif
+}
+
+static void unmap_file(hips_archive_t *archive)
+{
+#ifndef __EMSCRIPTEN__
+    if (archive->mapped) {
+        munmap((void*)archive->data, archive->size);
+        return;
+    }
+#endif
+    free((void*)archive->data);
+}
+
+static bool check_header(hips_archive_t *archive)
+{
+    uint32_t version;
+    uint64_t tiles_ofs, files_ofs;
+    const uint8_t *data = archive->data;
+
+    if (archive->size < HEADER_SIZE) return false;
+    if (memcmp(data, "HIPA", 4) != 0) return false;
+    memcpy(&version, data + 4, 4);
+    if (version != ARCHIVE_VERSION) {
+        LOG_E("Unsupported hips archive version: %d", version);
+        return false;
+    }
+    memcpy(&archive->nb_tiles, data + 8, 4);
+    memcpy(&archive->nb_files, data + 12, 4);
+    tiles_ofs = read_u64(data + 16);
+    files_ofs = read_u64(data + 24);
+    if (archive->nb_tiles < 0 || archive->nb_files < 0) return false;
+    if (tiles_ofs + (uint64_t)archive->nb_tiles * TILE_ENTRY_SIZE >
+            archive->size) return false;
+    if (files_ofs + (uint64_t)archive->nb_files * FILE_ENTRY_SIZE >
+            archive->size) return false;
+    archive->tiles = data + tiles_ofs;
+    archive->files = data + files_ofs;
+    return true;
+}
+
+hips_archive_t *hips_archive_open(const char *path)
+{
+    hips_archive_t *archive;
+
+    DL_FOREACH(g_archives, archive) {
+        if (strcmp(archive->path, path) == 0) {
+            archive->ref++;
+            return archive;
+        }
+    }
+    archive = calloc(1, sizeof(*archive));
+    archive->path = strdup(path);
+    archive->ref = 1;
+    if (!map_file(archive)) {
+        LOG_E("Cannot open hips archive %s", path);
+        free(archive->path);
+        free(archive);
+        return NULL;
+    }
+    if (!check_header(archive)) {
+        LOG_E("Wrong hips archive file %s", path);
+        unmap_file(archive);
+        free(archive->path);
+        free(archive);
+        return NULL;
+    }
+    DL_APPEND(g_archives, archive);
+    return archive;
+}
+
+void hips_archive_close(hips_archive_t *archive)
+{
+    if (!archive) return;
+    archive->ref--;
+    assert(archive->ref >= 0);
+    if (archive->ref > 0) return;
+    DL_DELETE(g_archives, archive);
+    unmap_file(archive);
+    free(archive->path);
+    free(archive);
+}
+
+// Return a data block from its offset and size, after checking that it
+// is inside the file and followed by its null byte.
+static const void *get_block(const hips_archive_t *archive,
+                             const uint8_t *entry, int *size)
+{
+    uint64_t ofs = read_u64(entry);
+    uint64_t block_size = read_u64(entry + 8);
+    if (ofs + block_size + 1 > archive->size || block_size > INT32_MAX ||
+        ofs + block_size + 1 < ofs || archive->data[ofs + block_size] != 0)
+    {
+        LOG_E("Wrong hips archive entry in %s", archive->path);
+        return NULL;
+    }
+    if (size) *size = block_size;
+    return archive->data + ofs;
+}
+
+const void *hips_archive_get_tile(const hips_archive_t *archive,
+                                  int order, int pix, int *size)
+{
+    const uint64_t nuniq = pix + 4 * (1ULL << (2 * order));
+    const uint8_t *entry;
+    uint64_t v;
+    int lo = 0, hi = archive->nb_tiles - 1, mid;
+
+    while (lo <= hi) {
+        mid = lo + (hi - lo) / 2;
+        entry = archive->tiles + (int64_t)mid * TILE_ENTRY_SIZE;
+        v = read_u64(entry);
+        if (v == nuniq) return get_block(archive, entry + 8, size);
+        if (v < nuniq) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return NULL;
+}
+
+const void *hips_archive_get_file(const hips_archive_t *archive,
+                                  const char *name, int *size)
+{
+    int i;
+    const uint8_t *entry;
+    for (i = 0; i < archive->nb_files; i++) {
+        entry = archive->files + i * FILE_ENTRY_SIZE;
+        if (strncmp((const char*)entry, name, FILE_NAME_SIZE) == 0)
+            return get_block(archive, entry + FILE_NAME_SIZE, size);
+    }
+    return NULL;
+}
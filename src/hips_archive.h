@@ -0,0 +1,92 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef HIPS_ARCHIVE_H
+#define HIPS_ARCHIVE_H
+
+#include <stdbool.h>
+
+/*
+ * File: hips_archive.h
+ * Read HiPS surveys packed into a single file.
+ *
+ * A survey archive contains all the tiles of a survey, indexed by nuniq,
+ * plus the other files of the survey (properties, Allsky).  It can be
+ * created with tools/make-hips-archive.py.  See hips_archive.c for the
+ * format.
+ *
+ * Passing the path of an archive to <hips_create> is enough to use it
+ * instead of a survey directory.
+ */
+
+// Extension of the archive files.
+#define HIPS_ARCHIVE_EXT ".hipsa"
+
+typedef struct hips_archive hips_archive_t;
+
+/*
+ * Function: hips_archive_is_archive
+ * Test if an url points to a survey archive.
+ */
+bool hips_archive_is_archive(const char *url);
+
+/*
+ * Function: hips_archive_open
+ * Open a survey archive.
+ *
+ * The archives are shared: opening the same path again only increases its
+ * reference counter.
+ *
+ * Return NULL in case of error.
+ */
+hips_archive_t *hips_archive_open(const char *path);
+
+/*
+ * Function: hips_archive_close
+ * Release a survey archive returned by hips_archive_open.
+ */
+void hips_archive_close(hips_archive_t *archive);
+
+/*
+ * Function: hips_archive_get_tile
+ * Get the data of a tile of the survey.
+ *
+ * The data is valid until the archive is closed, and is always followed by
+ * a null byte.
+ *
+ * Parameters:
+ *   archive - A survey archive.
+ *   order   - Order of the tile.
+ *   pix     - Pixel index of the tile.
+ *   size    - Receive the size of the data.
+ *
+ * Return:
+ *   A pointer to the data, or NULL if the tile is not in the archive.
+ */
+const void *hips_archive_get_tile(const hips_archive_t *archive,
+                                  int order, int pix, int *size);
+
+/*
+ * Function: hips_archive_get_file
+ * Get the data of a file of the survey that is not a tile.
+ *
+ * Parameters:
+ *   archive - A survey archive.
+ *   name    - Path of the file relative to the survey root, for example
+ *             'properties' or 'Norder3/Allsky.jpg'.
+ *   size    - Receive the size of the data.  Can be NULL.
+ *
+ * Return:
+ *   A pointer to the null terminated data, or NULL if the file is not in
+ *   the archive.
+ */
+const void *hips_archive_get_file(const hips_archive_t *archive,
+                                  const char *name, int *size);
+
+#endif // HIPS_ARCHIVE_H
@@ -165,6 +165,8 @@ void module_remove(obj_t *parent, obj_t *child)
     assert(child->parent == parent);
     assert(parent);
     assert(child->ref > 0);
+    if (core && parent == &core->obj) core_on_module_removed(child);
+    search_index_remove(child);
     child->parent = NULL;
     DL_DELETE(parent->children, child);
     obj_release(child);
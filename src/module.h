@@ -84,6 +84,42 @@ int module_add_data_source(obj_t *module, const char *url, const char *key);
  */
 obj_t *obj_get_by_hip(int hip, int *code);
 
+/*
+ * Function: obj_get_by_gaia
+ * Find a star object by its Gaia source id.
+ *
+ * This only works with the stars surveys that come with an ids index (see
+ * stars_index.h).  Same parameters and return value as <obj_get_by_hip>.
+ */
+obj_t *obj_get_by_gaia(uint64_t gaia, int *code);
+
+/*
+ * Function: obj_get_by_hips
+ * Find a list of star objects by their Hipparcos numbers.
+ *
+ * This is faster than calling <obj_get_by_hip> for each star, since the
+ * surveys indexes are only traversed once.
+ *
+ * Parameters:
+ *   nb     - Number of stars.
+ *   hips   - The Hipparcos numbers.
+ *   out    - Receive the star objects, or NULL.  The caller is responsible
+ *            for calling obj_release on the objects.
+ *   codes  - Receive the request code of each star, as in <obj_get_by_hip>.
+ *
+ * Return:
+ *   The number of stars found.
+ */
+int obj_get_by_hips(int nb, const int *hips, obj_t **out, int *codes);
+
+/*
+ * Function: obj_get_by_gaias
+ * Find a list of star objects by their Gaia source ids.
+ *
+ * Same as <obj_get_by_hips>, for Gaia ids.
+ */
+int obj_get_by_gaias(int nb, const uint64_t *gaias, obj_t **out, int *codes);
+
 /*
  * Function: module_get_render_order
  *
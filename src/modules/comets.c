@@ -533,6 +533,7 @@ static int comets_update(obj_t *obj, double dt)
     comets_t *comets = (void*)obj;
     double last_epoch = 0;
     char buf[128];
+    obj_t *child;
 
     if (comets->parsed || !comets->source_url)
         return 0;
@@ -556,11 +557,18 @@ static int comets_update(obj_t *obj, double dt)
     if (last_epoch < unix_to_mjd(sys_get_unix_time()) - 4)
         LOG_W("Warning: comets data seems outdated.");
 
+    // Index the comets designations, using the absolute magnitude to rank
+    // the completions.
+    DL_FOREACH(comets->obj.children, child)
+        search_index_add_obj(&comets->obj, child, ((comet_t*)child)->h);
+
     // Make sure the search work.
-    obj = core_search("NAME C/1995 O1 (Hale-Bopp)");
-    assert(obj && strcmp(obj->klass->id, "mpc_comet") == 0);
-    obj = core_search("NAME 1P/Halley");
-    assert(obj && strcmp(obj->klass->id, "mpc_comet") == 0);
+    child = core_search("NAME C/1995 O1 (Hale-Bopp)");
+    assert(child && strcmp(child->klass->id, "mpc_comet") == 0);
+    obj_release(child);
+    child = core_search("NAME 1P/Halley");
+    assert(child && strcmp(child->klass->id, "mpc_comet") == 0);
+    obj_release(child);
     return 0;
 }
 
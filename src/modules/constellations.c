@@ -192,22 +192,30 @@ static int constellation_get_info(const obj_t *obj, const observer_t *obs,
 // Return 0 if all the stars have been loaded (even if we had errors).
 static int constellation_create_stars(constellation_t *cons)
 {
-    int i, nb_err = 0, hip, code;
+    int i, nb_err = 0, hip, code, nb = cons->info.nb_lines * 2;
+    int *hips, *codes;
     assert(cons->lines.stars == NULL);
 
-    // Fetch all the stars used in the constellation lines
-    cons->lines.nb_stars = cons->info.nb_lines * 2;
-    cons->lines.stars = calloc(cons->info.nb_lines * 2, sizeof(obj_t*));
-    for (i = 0; i < cons->info.nb_lines * 2; i++) {
-        hip = cons->info.lines[i / 2].hip[i % 2];
-        assert(hip);
-        cons->lines.stars[i] = obj_get_by_hip(hip, &code);
-        if (code == 0) goto still_loading;
+    // Fetch all the stars used in the constellation lines at once.
+    cons->lines.nb_stars = nb;
+    cons->lines.stars = calloc(nb, sizeof(obj_t*));
+    hips = calloc(nb, sizeof(*hips));
+    codes = calloc(nb, sizeof(*codes));
+    for (i = 0; i < nb; i++) {
+        hips[i] = cons->info.lines[i / 2].hip[i % 2];
+        assert(hips[i]);
+    }
+    obj_get_by_hips(nb, hips, cons->lines.stars, codes);
+    for (i = 0; i < nb; i++) {
+        if (codes[i] == 0) break;
         if (!cons->lines.stars[i]) {
-            LOG_W("Cannot find line star HIP %d, code=%d", hip, code);
+            LOG_W("Cannot find line star HIP %d, code=%d", hips[i], codes[i]);
             nb_err++;
         }
     }
+    free(hips);
+    free(codes);
+    if (i < nb) goto still_loading;
     cons->lines.stars_pos = calloc(cons->lines.nb_stars,
                                    sizeof(*cons->lines.stars_pos));
 
@@ -559,7 +567,7 @@ static bool constellation_lines_in_view(const constellation_t *con,
         return false;
 
     // Clipping test.
-    pos = calloc(con->lines.nb_stars, sizeof(*pos));
+    pos = arena_calloc(painter->arena, con->lines.nb_stars, sizeof(*pos));
     for (i = 0; i < con->lines.nb_stars; i++) {
         if (!con->lines.stars[i]) continue;
         convert_frame(painter->obs, FRAME_ICRF, FRAME_VIEW, true,
@@ -567,10 +575,7 @@ static bool constellation_lines_in_view(const constellation_t *con,
         project_to_clip(painter->proj, pos[nb], pos[nb]);
         nb++;
     }
-    if (nb == 0) {
-        free(pos);
-        return true;
-    }
+    if (nb == 0) return true;
     // Compute margins in NDC.
     mx = m * painter->pixel_scale / painter->fb_size[0] * 2;
     my = m * painter->pixel_scale / painter->fb_size[1] * 2;
@@ -578,7 +583,6 @@ static bool constellation_lines_in_view(const constellation_t *con,
     my = fmin(my, 0.5);
 
     ret = !is_clipped(con->lines.nb_stars, pos, mx, my);
-    free(pos);
     return ret;
 }
 
@@ -653,7 +657,7 @@ static int render_lines(constellation_t *con, const painter_t *_painter,
     vec4_set(lines_color, 0.65, 1.0, 1.0, 0.4);
     vec4_emul(lines_color, painter.color, painter.color);
 
-    lines = calloc(con->lines.nb_stars, sizeof(*lines));
+    lines = arena_calloc(painter.arena, con->lines.nb_stars, sizeof(*lines));
     for (i = 0; i < con->lines.nb_stars; i++) {
         if (!con->lines.stars[i]) continue;
         vec3_copy(con->lines.stars_pos[i], lines[i]);
@@ -687,8 +691,6 @@ static int render_lines(constellation_t *con, const painter_t *_painter,
                    PAINTER_SKIP_DISCONTINUOUS);
     }
 
-    free(lines);
-
     return 0;
 }
 
@@ -256,24 +256,26 @@ static int on_file_tile_loaded(const char type[4],
     dso_t *s;
     int nb, i, j, version, data_ofs = 0, flags, row_size, order, pix;
     int children_mask;
-    char morpho[32], ids[256] = {};
-    double bmag, temp_mag, tmp_ra, tmp_de, tmp_smax, tmp_smin, tmp_angle;
+    char morpho[33], ids[257];
+    double bmag;
     void *tile_data;
     tile_t **out = USER_GET(user, 1); // Receive the tile.
     int *transparency = USER_GET(user, 2);
 
+    enum { TYPE, VMAG, BMAG, RA, DE, SMAX, SMIN, ANGL, MORP, IDS };
     eph_table_column_t columns[] = {
-        {"type", 's', .size=4},
-        {"vmag", 'f', EPH_VMAG},
-        {"bmag", 'f', EPH_VMAG},
-        {"ra",   'f', EPH_RAD},
-        {"de",   'f', EPH_RAD},
-        {"smax", 'f', EPH_RAD},
-        {"smin", 'f', EPH_RAD},
-        {"angl", 'f', EPH_RAD},
-        {"morp", 's', .size=32},
-        {"ids",  's', .size=256},
+        [TYPE] = {"type", 's', .size=4},
+        [VMAG] = {"vmag", 'f', EPH_VMAG},
+        [BMAG] = {"bmag", 'f', EPH_VMAG},
+        [RA]   = {"ra",   'f', EPH_RAD},
+        [DE]   = {"de",   'f', EPH_RAD},
+        [SMAX] = {"smax", 'f', EPH_RAD},
+        [SMIN] = {"smin", 'f', EPH_RAD},
+        [ANGL] = {"angl", 'f', EPH_RAD},
+        [MORP] = {"morp", 's', .size=32},
+        [IDS]  = {"ids",  's', .size=256},
     };
+    eph_column_view_t v[ARRAY_SIZE(columns)];
 
     *out = NULL;
     if (strncmp(type, "DSO ", 4) != 0) return 0;
@@ -282,16 +284,17 @@ static int on_file_tile_loaded(const char type[4],
     nb = eph_read_table_header(
             version, data, size, &data_ofs, &row_size, &flags,
             ARRAY_SIZE(columns), columns);
-    if (nb < 0) {
+    if (nb < 0 || columns[TYPE].size != 4 ||
+                  columns[MORP].size >= sizeof(morpho) ||
+                  columns[IDS].size >= sizeof(ids)) {
         LOG_E("Cannot parse file");
         return -1;
     }
     tile_data = eph_read_compressed_block(data, size, &data_ofs, &size);
     if (!tile_data) return -1;
-    data_ofs = 0;
-    if (flags & 1) {
-        eph_shuffle_bytes(tile_data + data_ofs, row_size, nb);
-    }
+    // Read the values directly from the table, without unshuffling it.
+    for (i = 0; i < ARRAY_SIZE(columns); i++)
+        eph_get_column_view(tile_data, nb, flags, &columns[i], &v[i]);
 
     tile = calloc(1, sizeof(*tile));
     tile->mag_min = DBL_MAX;
@@ -304,24 +307,22 @@ static int on_file_tile_loaded(const char type[4],
         s = &tile->sources[i];
         s->obj.ref = 1;
         s->obj.klass = &dso_klass;
-        eph_read_table_row(tile_data, size, &data_ofs,
-                           ARRAY_SIZE(columns), columns,
-                           s->obj.type,
-                           &temp_mag, &bmag, &tmp_ra, &tmp_de,
-                           &tmp_smax, &tmp_smin, &tmp_angle,
-                           morpho, ids);
-        s->ra = tmp_ra;
-        s->de = tmp_de;
-
-        s->smax = tmp_smax;
-        s->smin = tmp_smin;
-        s->angle = tmp_angle;
+        if (v[TYPE].data) eph_column_read(&v[TYPE], i, s->obj.type);
+        eph_column_get_s(&v[MORP], i, morpho);
+        eph_column_get_s(&v[IDS], i, ids);
+        bmag = eph_column_get_f(&v[BMAG], i);
+        s->ra = eph_column_get_f(&v[RA], i);
+        s->de = eph_column_get_f(&v[DE], i);
+
+        s->smax = eph_column_get_f(&v[SMAX], i);
+        s->smin = eph_column_get_f(&v[SMIN], i);
+        s->angle = eph_column_get_f(&v[ANGL], i);
         if (!s->smin && s->smax) {
             s->smin = s->smax;
             s->angle = NAN;
         }
 
-        s->vmag = temp_mag;
+        s->vmag = eph_column_get_f(&v[VMAG], i);
         // For the moment use bmag as fallback vmag value
         if (isnan(s->vmag)) s->vmag = bmag;
         if (memchr(s->obj.type, ' ', 4)) LOG_W_ONCE("Malformated otype");
@@ -377,6 +378,161 @@ static void *dsos_create_tile(void *user, int order, int pix,
     return tile;
 }
 
+/*
+ * Decoded tiles disk cache format (see hips_set_tile_cache_dir).
+ *
+ *   tile_header_t
+ *   dso_record_t[nb]
+ *   names and morpho strings of all the DSOs.
+ *
+ * Change DSOS_CACHE_VERSION when changing it.
+ */
+#define DSOS_CACHE_VERSION 1
+
+typedef struct {
+    int32_t     nb;
+    int32_t     flags;
+    double      mag_min;
+    double      mag_max;
+} tile_header_t;
+
+typedef struct {
+    double      bounding_cap[4];
+    float       display_vmag;
+    float       vmag;
+    float       ra;
+    float       de;
+    float       smin;
+    float       smax;
+    float       angle;
+    int32_t     symbol;
+    char        type[4] NONSTRING;
+    uint16_t    names_size;
+    uint16_t    morpho_size;
+} dso_record_t;
+
+// Return the size of a '\0' separated names list, including the final
+// extra '\0'.
+static int names_get_size(const char *names)
+{
+    const char *p = names;
+    if (!names) return 0;
+    while (*p) p += strlen(p) + 1;
+    return p - names + 1;
+}
+
+// Append size bytes to a buffer.
+static void write_bytes(UT_string *buf, const void *data, int size)
+{
+    utstring_bincpy(buf, data, size);
+}
+
+static void *dsos_save_tile(void *user, const void *tile_, int *size)
+{
+    const tile_t *tile = tile_;
+    const dso_t *s;
+    tile_header_t header = {tile->nb, tile->flags, tile->mag_min,
+                            tile->mag_max};
+    dso_record_t rec;
+    UT_string buf;
+    int i;
+
+    utstring_init(&buf);
+    write_bytes(&buf, &header, sizeof(header));
+    for (i = 0; i < tile->nb; i++) {
+        s = &tile->sources[i];
+        memset(&rec, 0, sizeof(rec));
+        memcpy(rec.bounding_cap, s->bounding_cap, sizeof(rec.bounding_cap));
+        rec.display_vmag = s->display_vmag;
+        rec.vmag = s->vmag;
+        rec.ra = s->ra;
+        rec.de = s->de;
+        rec.smin = s->smin;
+        rec.smax = s->smax;
+        rec.angle = s->angle;
+        rec.symbol = s->symbol;
+        memcpy(rec.type, s->obj.type, sizeof(rec.type));
+        rec.names_size = names_get_size(s->names);
+        rec.morpho_size = s->morpho ? strlen(s->morpho) + 1 : 0;
+        write_bytes(&buf, &rec, sizeof(rec));
+    }
+    for (i = 0; i < tile->nb; i++) {
+        s = &tile->sources[i];
+        if (s->names)
+            write_bytes(&buf, s->names, names_get_size(s->names));
+        if (s->morpho)
+            write_bytes(&buf, s->morpho, strlen(s->morpho) + 1);
+    }
+    *size = utstring_len(&buf);
+    return utstring_body(&buf);
+}
+
+static void *dsos_load_tile(void *user, int order, int pix,
+                            const void *data, int size, int *cost)
+{
+    const uint8_t *p = data, *end = p + size;
+    const dso_record_t *recs;
+    tile_header_t header;
+    tile_t *tile;
+    dso_t *s;
+    int i;
+
+    if (size < sizeof(header)) return NULL;
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    if (header.nb < 0 || end - p < header.nb * sizeof(*recs)) return NULL;
+    recs = (const dso_record_t*)p;
+    p += header.nb * sizeof(*recs);
+
+    tile = calloc(1, sizeof(*tile));
+    tile->nb = header.nb;
+    tile->flags = header.flags;
+    tile->mag_min = header.mag_min;
+    tile->mag_max = header.mag_max;
+    tile->sources = calloc(tile->nb, sizeof(*tile->sources));
+    tile->sources_quick = calloc(tile->nb, sizeof(*tile->sources_quick));
+    for (i = 0; i < tile->nb; i++) {
+        s = &tile->sources[i];
+        s->obj.ref = 1;
+        s->obj.klass = &dso_klass;
+        memcpy(s->obj.type, recs[i].type, sizeof(s->obj.type));
+        memcpy(s->bounding_cap, recs[i].bounding_cap,
+               sizeof(s->bounding_cap));
+        s->display_vmag = recs[i].display_vmag;
+        s->vmag = recs[i].vmag;
+        s->ra = recs[i].ra;
+        s->de = recs[i].de;
+        s->smin = recs[i].smin;
+        s->smax = recs[i].smax;
+        s->angle = recs[i].angle;
+        s->symbol = recs[i].symbol;
+        // Also make sure the strings are terminated (see names_get_size).
+        if (end - p < recs[i].names_size + recs[i].morpho_size ||
+            (recs[i].names_size && (p[recs[i].names_size - 1] ||
+                (recs[i].names_size > 1 && p[recs[i].names_size - 2]))) ||
+            (recs[i].morpho_size &&
+                p[recs[i].names_size + recs[i].morpho_size - 1]))
+        {
+            tile->nb = i;
+            del_tile(tile);
+            return NULL;
+        }
+        if (recs[i].names_size) {
+            s->names = malloc(recs[i].names_size);
+            memcpy(s->names, p, recs[i].names_size);
+            p += recs[i].names_size;
+        }
+        if (recs[i].morpho_size) {
+            s->morpho = malloc(recs[i].morpho_size);
+            memcpy(s->morpho, p, recs[i].morpho_size);
+            p += recs[i].morpho_size;
+        }
+        tile->sources_quick[i] = s->clip_data;
+    }
+    *cost = tile->nb * sizeof(*tile->sources);
+    return tile;
+}
+
 static int dsos_init(obj_t *obj, json_value *args)
 {
     dsos_t *dsos = (dsos_t*)obj;
@@ -389,6 +545,29 @@ static int dsos_init(obj_t *obj, json_value *args)
     return 0;
 }
 
+/*
+ * Add the names of a tile to the search index the first time we get it.
+ */
+static void index_tile(survey_t *survey, const tile_t *tile,
+                       int order, int pix)
+{
+    int i;
+    const char *name;
+    uint64_t nuniq = pix_to_nuniq(order, pix);
+
+    if (search_index_has_hint(&g_dsos->obj, survey->key, nuniq)) return;
+    for (i = 0; i < tile->nb; i++) {
+        for (name = tile->sources[i].names; name && *name;
+             name += strlen(name) + 1)
+        {
+            search_index_add_hint(&g_dsos->obj, survey->key, nuniq, name,
+                                  tile->sources[i].vmag);
+        }
+    }
+    // Mark the tile as indexed even if it has no names.
+    search_index_add_hint(&g_dsos->obj, survey->key, nuniq, NULL, NAN);
+}
+
 // Exactly the same that stars.c get_tile function...
 static tile_t *get_tile(survey_t *survey, int order, int pix,
                         bool sync, int *code)
@@ -402,6 +581,7 @@ static tile_t *get_tile(survey_t *survey, int order, int pix,
         return NULL;
     }
     tile = hips_get_tile(survey->hips, order, pix, flags, code);
+    if (tile) index_tile(survey, tile, order, pix);
     return tile;
 }
 
@@ -669,6 +849,11 @@ static int dsos_render(obj_t *obj, const painter_t *painter_)
     DL_FOREACH(dsos->surveys, survey) {
         hips_traverse(USER_PASS(&painter, &nb_tot, &nb_loaded, survey),
                       render_visitor);
+        // Load the tiles ahead of the camera movements.
+        if (core->view_prediction.active && dsos->visible.value) {
+            hips_prefetch(survey->hips, &painter, core->view_prediction.pos,
+                          core->view_prediction.fov);
+        }
     }
     progressbar_report("DSO", "DSO", nb_loaded, nb_tot, -1);
     return 0;
@@ -730,6 +915,43 @@ static int dsos_list(const obj_t *obj,
     return 0;
 }
 
+static int dsos_list_cone(const obj_t *obj, const double cap[4],
+                          double max_mag, void *user,
+                          int (*f)(void *user, obj_t *obj))
+{
+    int order, pix, i, code, ret = 0;
+    double tile_cap[4], vmag;
+    const dsos_t *dsos = (const dsos_t*)obj;
+    tile_t *tile;
+    hips_iterator_t iter;
+    survey_t *survey;
+
+    if (isnan(max_mag)) max_mag = DBL_MAX;
+    DL_FOREACH(dsos->surveys, survey) {
+        hips_iter_init(&iter);
+        while (hips_iter_next(&iter, &order, &pix)) {
+            healpix_get_bounding_cap(1 << order, pix, tile_cap);
+            if (!cap_intersects_cap(cap, tile_cap)) continue;
+            tile = get_tile(survey, order, pix, false, &code);
+            if (!tile) {
+                if (!code) ret = MODULE_AGAIN;
+                continue;
+            }
+            if (tile->mag_min >= max_mag) continue;
+            for (i = 0; i < tile->nb; i++) {
+                vmag = tile->sources[i].vmag;
+                if (!isnan(vmag) && vmag > max_mag) continue;
+                // The bounding cap is centered on the dso.
+                if (!cap_contains_vec3(cap, tile->sources[i].bounding_cap))
+                    continue;
+                if (f(user, &tile->sources[i].obj)) return ret;
+            }
+            hips_iter_push_children(&iter, order, pix);
+        }
+    }
+    return ret;
+}
+
 static int dsos_add_data_source(obj_t *obj, const char *url, const char *key)
 {
     dsos_t *dsos = (void*)obj;
@@ -738,6 +960,9 @@ static int dsos_add_data_source(obj_t *obj, const char *url, const char *key)
     hips_settings_t survey_settings = {
         .create_tile = dsos_create_tile,
         .delete_tile = del_tile,
+        .save_tile = dsos_save_tile,
+        .load_tile = dsos_load_tile,
+        .cache_version = DSOS_CACHE_VERSION,
     };
     DL_COUNT(dsos->surveys, survey, idx);
     survey = calloc(1, sizeof(*survey));
@@ -774,6 +999,7 @@ static obj_klass_t dsos_klass = {
     .update = dsos_update,
     .render = dsos_render,
     .list   = dsos_list,
+    .list_cone = dsos_list_cone,
     .add_data_source = dsos_add_data_source,
     .render_order = 25,
     .attributes = (attribute_t[]) {
@@ -35,6 +35,13 @@ static int dss_render(obj_t *obj, const painter_t *painter)
     if (dss->visible.value == 0.0) return 0;
     if (!dss->hips) return 0;
 
+    // Load the tiles ahead of the camera movements.
+    if (core->view_prediction.active &&
+            core->view_prediction.fov < 20 * DD2R) {
+        hips_prefetch(dss->hips, painter, core->view_prediction.pos,
+                      core->view_prediction.fov);
+    }
+
     // For large FOV we use the milky way texture
     visibility = smoothstep(20 * DD2R, 10 * DD2R, core->fov);
     painter2.color[3] *= dss->visible.value;
@@ -120,27 +120,91 @@ static double bounds_dist_point(const double rect[4], const double p[2])
     return sqrt(dx * dx + dy * dy);
 }
 
+/*
+ * Screen space grid of the labels bounds, rebuilt every frame in the painter
+ * arena, so that we only test the overlaps with the labels that are close.
+ */
+#define GRID_CELL_SIZE 64 // Window pixels.
+
+typedef struct grid_node grid_node_t;
+struct grid_node {
+    grid_node_t *next;
+    label_t     *label;
+};
+
+typedef struct {
+    int         w, h;   // Number of cells.
+    grid_node_t **cells;
+} grid_t;
+
+// Get the range of grid cells covered by some bounds.
+// Return false if the bounds are not valid.
+static bool grid_get_range(const grid_t *grid, const double bounds[4],
+                           int range[4])
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+        if (isnan(bounds[i])) return false;
+        range[i] = clamp(bounds[i] / GRID_CELL_SIZE, 0,
+                         (i % 2 ? grid->h : grid->w) - 1);
+    }
+    return true;
+}
+
+static void grid_init(grid_t *grid, arena_t *arena, const painter_t *painter)
+{
+    label_t *label;
+    grid_node_t *node;
+    int x, y, range[4];
+
+    grid->w = fmax(1, ceil(painter->fb_size[0] / painter->pixel_scale /
+                           GRID_CELL_SIZE));
+    grid->h = fmax(1, ceil(painter->fb_size[1] / painter->pixel_scale /
+                           GRID_CELL_SIZE));
+    grid->cells = arena_calloc(arena, grid->w * grid->h,
+                               sizeof(*grid->cells));
+    DL_FOREACH(g_labels->labels, label) {
+        if (!grid_get_range(grid, label->bounds, range)) continue;
+        for (y = range[1]; y <= range[3]; y++)
+        for (x = range[0]; x <= range[2]; x++) {
+            node = arena_alloc(arena, sizeof(*node));
+            node->label = label;
+            node->next = grid->cells[y * grid->w + x];
+            grid->cells[y * grid->w + x] = node;
+        }
+    }
+}
+
 /*
  * Compute the overlap between a label and any other label on screen.
  * We define the overlap as the minimum length in X or Y of the
  * overlapping rectangle area of the label.
  */
-static double test_label_overlaps(const label_t *label)
+static double test_label_overlaps(const grid_t *grid, const label_t *label)
 {
-    label_t *other;
+    const label_t *other;
+    const grid_node_t *node;
     double ret = 0, overlap;
     double inter[4];
+    int x, y, range[4];
 
     if (!(label->effects & TEXT_FLOAT)) return 0.0;
-    DL_FOREACH(g_labels->labels, other) {
-        if (other->priority < label->priority) continue;
-        if (other == label) continue;
-        if (other->fader.target == false) continue;
-        if (!bounds_intersection(label->bounds, other->bounds, inter))
-            continue;
-        overlap = fmin(inter[2] - inter[0], inter[3] - inter[1]);
-        if (overlap > ret)
-            ret = overlap;
+    if (!grid_get_range(grid, label->bounds, range)) return 0.0;
+    // Note: a label covering several cells can be tested several times,
+    // it doesn't matter since we only keep the max overlap.
+    for (y = range[1]; y <= range[3]; y++)
+    for (x = range[0]; x <= range[2]; x++) {
+        for (node = grid->cells[y * grid->w + x]; node; node = node->next) {
+            other = node->label;
+            if (other->priority < label->priority) continue;
+            if (other == label) continue;
+            if (other->fader.target == false) continue;
+            if (!bounds_intersection(label->bounds, other->bounds, inter))
+                continue;
+            overlap = fmin(inter[2] - inter[0], inter[3] - inter[1]);
+            if (overlap > ret)
+                ret = overlap;
+        }
     }
     return ret;
 }
@@ -153,6 +217,40 @@ static int label_cmp(void *a_, void *b_)
     return -cmp(vec3_norm2(a->pos), vec3_norm2(b->pos));
 }
 
+/*
+ * Sort the labels from far to near.
+ *
+ * The order barely changes from one frame to the next, so we use an
+ * insertion sort starting from the previous order, that is O(n) if nothing
+ * moved.  If too many labels moved we fall back to a merge sort.  Both are
+ * stable so the result is the same.
+ */
+static void labels_sort(void)
+{
+    label_t *sorted = NULL, *label, *pos;
+    int nb, nb_moves = 0;
+
+    DL_COUNT(g_labels->labels, label, nb);
+    while ((label = g_labels->labels)) {
+        DL_DELETE(g_labels->labels, label);
+        pos = sorted ? sorted->prev : NULL; // Tail of the sorted list.
+        while (pos && label_cmp(pos, label) > 0) {
+            pos = (pos == sorted) ? NULL : pos->prev;
+            nb_moves++;
+        }
+        if (pos)
+            DL_APPEND_ELEM(sorted, pos, label);
+        else
+            DL_PREPEND(sorted, label);
+        if (nb_moves > 8 * nb) {
+            DL_CONCAT(sorted, g_labels->labels);
+            DL_SORT(sorted, label_cmp);
+            break;
+        }
+    }
+    g_labels->labels = sorted;
+}
+
 static int labels_init(obj_t *obj, json_value *args)
 {
     g_labels = (void*)obj;
@@ -165,27 +263,39 @@ static int labels_render(obj_t *obj, const painter_t *painter_)
     double pos[2];
     const double max_overlap = 8;
     painter_t painter = *painter_;
+    grid_t grid;
+
+    painter.flags &= ~PAINTER_ENABLE_DEPTH;
 
     // Order labels to render them from far to near.
-    DL_SORT(g_labels->labels, label_cmp);
-    DL_FOREACH(g_labels->labels, label) {
+    labels_sort();
 
+    // First compute all the labels bounds, so that we can put them in
+    // the grid.
+    DL_FOREACH(g_labels->labels, label) {
         if (g_labels->hidden_obj && label->obj == g_labels->hidden_obj)
             continue;
-
-        vec4_copy(label->color, painter.color);
-        painter.color[3] *= label->fader.value;
         // Re-project label on screen
         if (label->frame != -1) {
             painter_project(&painter, label->frame, label->pos, label->at_inf,
                             false, label->win_pos);
         }
-        painter.flags &= ~PAINTER_ENABLE_DEPTH;
         label_apply_radius_offset(label, pos);
         paint_text_bounds(&painter, label->render_text, pos, label->align,
                           label->effects, label->size, label->bounds);
+    }
+    grid_init(&grid, painter.arena, &painter);
+
+    DL_FOREACH(g_labels->labels, label) {
+
+        if (g_labels->hidden_obj && label->obj == g_labels->hidden_obj)
+            continue;
+
+        vec4_copy(label->color, painter.color);
+        painter.color[3] *= label->fader.value;
+        label_apply_radius_offset(label, pos);
         label->fader.target = label->active &&
-                                (test_label_overlaps(label) <= max_overlap);
+                        (test_label_overlaps(&grid, label) <= max_overlap);
 
         if (label->frame != -1 &&
                 core_is_point_occulted(label->pos, label->at_inf,
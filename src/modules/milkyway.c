@@ -41,6 +41,13 @@ static int milkyway_render(obj_t *obj, const painter_t *painter_)
     if (!mw->hips) return 0;
     if (mw->visible.value == 0.0) return 0;
 
+    // Load the tiles ahead of the camera movements.
+    if (core->view_prediction.active &&
+            core->view_prediction.fov > 10 * DD2R) {
+        hips_prefetch(mw->hips, &painter, core->view_prediction.pos,
+                      core->view_prediction.fov);
+    }
+
     // For small FOV we use the DSS texture
     visibility = smoothstep(10 * DD2R, 20 * DD2R, core->fov);
     painter.color[3] *= mw->visible.value * visibility;
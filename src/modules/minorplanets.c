@@ -164,6 +164,8 @@ static void load_data(mplanets_t *mplanets, const char *data, int size)
             _Static_assert(sizeof(desig) == sizeof(mplanet->desig), "");
             memcpy(mplanet->desig, desig, sizeof(desig));
         }
+        // Use the absolute magnitude to rank the search completions.
+        search_index_add_obj(&mplanets->obj, &mplanet->obj, h);
     }
     if (nb_err) {
         LOG_W("Minor planet data got %d errors lines.", nb_err);
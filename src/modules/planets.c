@@ -1543,6 +1543,12 @@ static int planets_init(obj_t *obj, json_value *args)
         continue;
     }
 
+    // Use an arbitrary bright magnitude so that the planets and moons come
+    // before the minor bodies in the search completions.
+    PLANETS_ITER(obj, p) {
+        search_index_add_obj(obj, &p->obj, 0);
+    }
+
     return 0;
 }
 
@@ -1569,6 +1575,7 @@ static int planets_add_data_source(
         hips_delete(planets->default_hips);
         planets->default_hips = hips_create(url, 0, NULL);
         hips_set_frame(planets->default_hips, FRAME_ICRF);
+        planets->default_hips->fetch.no_distance = true;
         return 0;
     }
 
@@ -1577,6 +1584,7 @@ static int planets_add_data_source(
         hips_delete(p->hips_normalmap);
         p->hips_normalmap = hips_create(url, 0, NULL);
         hips_set_frame(p->hips_normalmap, FRAME_ICRF);
+        p->hips_normalmap->fetch.no_distance = true;
         return 0;
     }
 
@@ -1585,6 +1593,7 @@ static int planets_add_data_source(
     hips_delete(p->hips);
     p->hips = hips_create(url, 0, NULL);
     hips_set_frame(p->hips, FRAME_ICRF);
+    p->hips->fetch.no_distance = true;
     return 0;
 }
 
@@ -113,6 +113,7 @@ static int load_jsonl_data(satellites_t *sats, const char *data, int size,
         json_value_free(json);
         if (!sat) goto error;
         *last_epoch = fmax(*last_epoch, sgp4_get_satepoch(sat->elsetrec));
+        search_index_add_obj(&sats->obj, &sat->obj, sat->max_brightness);
         nb++;
         continue;
 error:
@@ -115,9 +115,32 @@ static void skyculture_deactivate(skyculture_t *cult)
     // Remove all the constellation objects.
     constellations = core_get_module("constellations");
     assert(constellations);
+    search_index_remove(constellations);
     DL_FOREACH_SAFE(constellations->children, cst, tmp) {
         module_remove(constellations, cst);
     }
+    search_index_remove(cult->obj.parent);
+}
+
+// Add the sky culture common names to the search index.
+static void index_names(skyculture_t *cult)
+{
+    skyculture_name_t *item, *tmp, *name;
+    obj_t *module = cult->obj.parent;
+
+    HASH_ITER(hh, cult->names, item, tmp) {
+        for (name = item; name; name = name->alternative) {
+            if (name->name_english)
+                search_index_add_alias(module, name->name_english,
+                                       item->main_id);
+            if (name->name_native)
+                search_index_add_alias(module, name->name_native,
+                                       item->main_id);
+            if (name->name_pronounce)
+                search_index_add_alias(module, name->name_pronounce,
+                                       item->main_id);
+        }
+    }
 }
 
 static void skyculture_activate(skyculture_t *cult)
@@ -125,7 +148,7 @@ static void skyculture_activate(skyculture_t *cult)
     int i;
     json_value *args;
     constellation_infos_t *cst;
-    obj_t *constellations;
+    obj_t *constellations, *child;
 
     // Create all the constellations object.
     constellations = core_get_module("constellations");
@@ -143,6 +166,10 @@ static void skyculture_activate(skyculture_t *cult)
         json_builder_free(args);
     }
 
+    DL_FOREACH(constellations->children, child)
+        search_index_add_obj(constellations, child, NAN);
+    index_names(cult);
+
     obj_set_attr(constellations, "illustrations_bscale",
                  cult->illustrations_bscale),
     // Set the current attribute of the skycultures manager object.
@@ -12,6 +12,7 @@
 #include "hip.h"
 #include "designation.h"
 #include "ini.h"
+#include "stars_index.h"
 
 #include <regex.h>
 #include <zlib.h>
@@ -20,6 +21,11 @@
 
 static const double LABEL_SPACING = 4;
 
+// Max observer time change (day) before we recompute the cached stars
+// astrometric positions.  In one minute, even the fastest stars move by
+// less than 0.1 mas.
+static const double ASTROM_MAX_DT = 1.0 / 24 / 60;
+
 static obj_klass_t star_klass;
 
 typedef struct stars stars_t;
@@ -49,6 +55,9 @@ struct survey {
     double  min_vmag; // Don't render survey below this mag.
     double  max_vmag;
     bool    is_gaia;
+    // Ids index, if the survey has one (see stars_index.h).
+    char    *index_path;
+    stars_index_t *index;
     survey_t *next, *prev;
 };
 
@@ -69,19 +78,95 @@ struct stars {
 // Static instance.
 static stars_t *g_stars = NULL;
 
+/*
+ * Type: star_data_t
+ * Per star data of a tile that is not needed for rendering.  Only used
+ * to create the star objects.
+ */
+typedef struct {
+    uint64_t    gaia;
+    int         hip;
+    char        type[4] NONSTRING;
+    float       plx;
+    double      distance;
+    char        *names;
+    char        *sp_type;
+} star_data_t;
+
+/*
+ * Type: tile_chunk_t
+ * A magnitude chunk of a tile source file.
+ *
+ * The tiles of the deep surveys can be split into several chunks sorted by
+ * magnitude (see tools/make-stars-chunks.py).  We only decode a chunk the
+ * first time we need stars that faint, until then we just keep a copy of
+ * its compressed data.
+ */
+typedef struct {
+    float       mag_min;
+    float       mag_max;
+    int         start;  // Index of the first star in the tile, once decoded.
+    int         nb;     // Number of stars, once decoded.
+    void        *data;  // Chunk source data, NULL once decoded.
+    int         size;
+} tile_chunk_t;
+
 /*
  * Type: tile_t
  * Custom tile structure for the stars hips survey.
+ *
+ * The data used for rendering is stored as separate arrays, all sorted by
+ * vmag, so that the render loop only touches what it needs.  The star
+ * objects are only created when needed (when a star can be picked, has a
+ * label, or is listed), and then owned by the tile.
+ *
+ * The arrays only contain the stars of the chunks decoded so far.  The
+ * mag_min and mag_max values are for all the chunks.
  */
 typedef struct tile {
     int         flags;
     double      mag_min;
     double      mag_max;
     double      illuminance; // Totall illuminance (lux).
-    int         nb;
-    star_t      *sources;
+    int         nb;          // Number of decoded stars.
+
+    int          nb_chunks;
+    int          nb_decoded; // The first nb_decoded chunks are decoded.
+    int          nb_indexed; // Chunks added to the search index.
+    tile_chunk_t *chunks;
+
+    // Render data.
+    double      (*pos)[3];  // Barycentric position at J2000 (AU).
+    double      (*pm)[3];   // Proper motion (AU/day).
+    float       *vmag;
+    float       *bv;
+    float       *illuminances; // (lux).
+
+    star_data_t *data;
+    star_t      **stars;    // Created on demand, can be NULL.
+
+    // Cached astrometric positions of the first nb_astrom stars, at the
+    // time astrom_tt (see tile_get_astrom_n).
+    double      (*astrom)[3];
+    int         astrom_size;
+    int         nb_astrom;
+    double      astrom_tt;
+
+    // Decode the next pending chunks in a thread (see tile_decode).
+    struct {
+        worker_t        worker;
+        const survey_t  *survey;
+        const tile_chunk_t *chunks; // First chunk to decode.
+        int             nb_chunks;
+        struct tile     *tile;      // Receive the decoded stars.
+    } *decoder;
 } tile_t;
 
+static uint64_t pix_to_nuniq(int order, int pix)
+{
+    return pix + 4 * (1L << (2 * order));
+}
+
 static void nuniq_to_pix(uint64_t nuniq, int *order, int *pix)
 {
     *order = log2(nuniq / 4) / 2;
@@ -98,7 +183,8 @@ static void nuniq_to_pix(uint64_t nuniq, int *order, int *pix)
  *   plx    - Parallax (arcseconds).
  */
 static void compute_pv(double ra, double de, double pra, double pde,
-                       double plx, double epoch, star_t *s)
+                       double plx, double epoch, double pvo[2][3],
+                       double *distance)
 {
     int r;
     double djm0, djm = 0;
@@ -114,7 +200,7 @@ static void compute_pv(double ra, double de, double pra, double pde,
 
     // Pre-compute 3D position and speed in catalog/barycentric position
     // at epoch 2000, to broadly match DSS images.
-    r = eraStarpv(ra, de, pra / cos(de), pde, plx, 0, s->pvo);
+    r = eraStarpv(ra, de, pra / cos(de), pde, plx, 0, pvo);
     if (r & (2 | 4)) {
         LOG_W("Wrong star coordinates");
         if (r & 2) LOG_W("Excessive speed");
@@ -125,15 +211,15 @@ static void compute_pv(double ra, double de, double pra, double pde,
               plx * 1000);
     }
     if (r & 1) {
-        s->distance = NAN;
+        *distance = NAN;
     } else {
-        s->distance = vec3_norm(s->pvo[0]);
+        *distance = vec3_norm(pvo[0]);
     }
 
     // Apply proper motion to bring from catalog epoch to 2000.0 epoch
     eraEpb2jd(epoch, &djm0, &djm);
     double dt = ERFA_DJM00 - djm;
-    vec3_addk(s->pvo[0], s->pvo[1], dt, s->pvo[0]);
+    vec3_addk(pvo[0], pvo[1], dt, pvo[0]);
 }
 
 // Turn a json array of string into a '\0' separated C string.
@@ -172,7 +258,8 @@ static int star_init(obj_t *obj, json_value *args)
         if (isnan(star->vmag))
             star->vmag = json_get_attr_f(model, "Bmag", NAN);
         star->illuminance = core_mag_to_illuminance(star->vmag);
-        compute_pv(ra, de, pra, pde, star->plx, epoch, star);
+        compute_pv(ra, de, pra, pde, star->plx, epoch, star->pvo,
+                   &star->distance);
     }
 
     names = json_get_attr(args, "names", json_array);
@@ -308,6 +395,14 @@ static bool star_get_bayer_name(const star_t *s, char *out, int size,
 }
 
 
+// Return the max vmag for which we show the stars names at a given position.
+static double get_hints_lim_mag(const painter_t *painter,
+                                const double win_pos[2])
+{
+    return painter->hints_limit_mag - 5 + g_stars->hints_mag_offset +
+           core_get_hints_mag_offset(win_pos);
+}
+
 static void star_render_name(const painter_t *painter, const star_t *s,
                              int frame, const double pos[3],
                              const double win_pos[2], double radius,
@@ -319,14 +414,12 @@ static void star_render_name(const painter_t *painter, const star_t *s,
     int effects = TEXT_FLOAT;
     char buf[128];
     const char *name;
-    const double hints_mag_offset = g_stars->hints_mag_offset +
-                                    core_get_hints_mag_offset(win_pos);
     int flags = DSGN_TRANSLATE;
     const char *first_name = NULL;
 
-    double lim_mag = painter->hints_limit_mag - 5 + hints_mag_offset;
-    double lim_mag2 = painter->hints_limit_mag - 7.5 + hints_mag_offset;
-    double lim_mag3 = painter->hints_limit_mag - 9.0 + hints_mag_offset;
+    double lim_mag = get_hints_lim_mag(painter, win_pos);
+    double lim_mag2 = lim_mag - 2.5;
+    double lim_mag3 = lim_mag - 4.0;
 
     // Decide whether a label must be displayed
     if (!selected && s->vmag > lim_mag)
@@ -432,71 +525,182 @@ static int del_tile(void *data)
     int i;
     tile_t *tile = data;
 
+    // Can't delete the tile while its chunks are decoded in a thread.
+    if (tile->decoder && worker_is_running(&tile->decoder->worker))
+        return CACHE_KEEP;
     // Don't delete the tile if any contained star is used somehwere else.
-    for (i = 0; i < tile->nb; i++) {
-        if (tile->sources[i].obj.ref > 1) return CACHE_KEEP;
+    for (i = 0; tile->stars && i < tile->nb; i++) {
+        if (tile->stars[i] && tile->stars[i]->obj.ref > 1) return CACHE_KEEP;
     }
 
     for (i = 0; i < tile->nb; i++) {
-        free(tile->sources[i].names);
-        free(tile->sources[i].sp_type);
+        if (tile->stars) free(tile->stars[i]);
+        free(tile->data[i].names);
+        free(tile->data[i].sp_type);
     }
-    free(tile->sources);
+    for (i = 0; i < tile->nb_chunks; i++) free(tile->chunks[i].data);
+    if (tile->decoder) {
+        del_tile(tile->decoder->tile);
+        free(tile->decoder);
+    }
+    free(tile->chunks);
+    free(tile->stars);
+    free(tile->astrom);
+    free(tile->pos);
+    free(tile->pm);
+    free(tile->vmag);
+    free(tile->bv);
+    free(tile->illuminances);
+    free(tile->data);
     free(tile);
     return 0;
 }
 
-static int star_data_cmp(const void *a, const void *b)
+/*
+ * Get the star object of a tile, creating it if needed.
+ * The returned star is owned by the tile.
+ */
+static star_t *tile_get_star(tile_t *tile, int i)
 {
-    return cmp(((const star_t*)a)->vmag, ((const star_t*)b)->vmag);
+    star_t *s;
+    const star_data_t *data = &tile->data[i];
+
+    if (!tile->stars) tile->stars = calloc(tile->nb, sizeof(*tile->stars));
+    if (tile->stars[i]) return tile->stars[i];
+
+    s = calloc(1, sizeof(*s));
+    s->obj.ref = 1;
+    s->obj.klass = &star_klass;
+    memcpy(s->obj.type, data->type, sizeof(s->obj.type));
+    s->gaia = data->gaia;
+    s->hip = data->hip;
+    s->vmag = tile->vmag[i];
+    s->plx = data->plx;
+    s->bv = tile->bv[i];
+    s->illuminance = tile->illuminances[i];
+    vec3_copy(tile->pos[i], s->pvo[0]);
+    vec3_copy(tile->pm[i], s->pvo[1]);
+    s->distance = data->distance;
+    // Owned by the tile.
+    s->names = data->names;
+    s->sp_type = data->sp_type;
+    tile->stars[i] = s;
+    return s;
 }
 
-static int on_file_tile_loaded(const char type[4],
-                               const void *data, int size,
-                               const json_value *json,
-                               void *user)
+/*
+ * Return the astrometric positions of the n first stars of a tile.
+ * Same as star_get_astrom, but for all the stars at once.
+ *
+ * The positions are cached in the tile, and only recomputed when the
+ * observer time moves by more than ASTROM_MAX_DT, so that when we just pan
+ * the view the stars only need to be projected.  The returned array is
+ * owned by the tile.
+ */
+static double (*tile_get_astrom_n(tile_t *tile, const observer_t *obs,
+                                  int n))[3]
 {
-    int version, nb, data_ofs = 0, row_size, flags, i, j, order, pix;
-    int children_mask;
-    double vmag, gmag, ra, de, pra, pde, plx, bv, epoch;
-    char ids[256] = {};
-    char sp_type[32] = {};
-    survey_t *survey = USER_GET(user, 0);
-    tile_t **out = USER_GET(user, 1); // Receive the tile.
-    int *transparency = USER_GET(user, 2);
-    tile_t *tile;
+    int i;
+    double v[3], dt = obs->tt - ERFA_DJM00;
+
+    if (fabs(obs->tt - tile->astrom_tt) > ASTROM_MAX_DT) {
+        tile->astrom_tt = obs->tt;
+        tile->nb_astrom = 0;
+    }
+    if (n <= tile->nb_astrom) return tile->astrom;
+    // Allocate for all the decoded stars at once (see tile_get_cost).
+    if (tile->astrom_size < tile->nb) {
+        tile->astrom = realloc(tile->astrom, tile->nb * sizeof(*tile->astrom));
+        tile->astrom_size = tile->nb;
+    }
+    // Only compute the new stars.
+    for (i = tile->nb_astrom; i < n; i++) {
+        v[0] = tile->pos[i][0] + tile->pm[i][0] * dt - obs->earth_pvb[0][0];
+        v[1] = tile->pos[i][1] + tile->pm[i][1] * dt - obs->earth_pvb[0][1];
+        v[2] = tile->pos[i][2] + tile->pm[i][2] * dt - obs->earth_pvb[0][2];
+        vec3_normalize(v, tile->astrom[i]);
+    }
+    tile->nb_astrom = n;
+    return tile->astrom;
+}
+
+// Add n stars at the end of the tile arrays.  Only the data and stars
+// values are initialized.
+static void tile_grow(tile_t *tile, int n)
+{
+    int start = tile->nb;
+    tile->nb += n;
+    tile->pos = realloc(tile->pos, tile->nb * sizeof(*tile->pos));
+    tile->pm = realloc(tile->pm, tile->nb * sizeof(*tile->pm));
+    tile->vmag = realloc(tile->vmag, tile->nb * sizeof(*tile->vmag));
+    tile->bv = realloc(tile->bv, tile->nb * sizeof(*tile->bv));
+    tile->illuminances = realloc(tile->illuminances,
+                                 tile->nb * sizeof(*tile->illuminances));
+    tile->data = realloc(tile->data, tile->nb * sizeof(*tile->data));
+    memset(tile->data + start, 0, n * sizeof(*tile->data));
+    if (tile->stars) {
+        tile->stars = realloc(tile->stars, tile->nb * sizeof(*tile->stars));
+        memset(tile->stars + start, 0, n * sizeof(*tile->stars));
+    }
+}
+
+// Used to sort the rows of a tile by vmag before loading them.
+typedef struct {
+    float   vmag;
+    int     row;
+} row_mag_t;
+
+// Sort by vmag, then by row so that the order is deterministic (the
+// stars indexes rely on it).
+static int row_mag_cmp(const void *a_, const void *b_)
+{
+    const row_mag_t *a = a_, *b = b_;
+    if (a->vmag != b->vmag) return cmp(a->vmag, b->vmag);
+    return cmp(a->row, b->row);
+}
+
+/*
+ * Decode the table of a STAR or GAIA chunk, and append its stars to the
+ * tile arrays.
+ *
+ * Return the number of stars added, or -1 in case of error.
+ */
+static int tile_add_stars(tile_t *tile, const survey_t *survey, int version,
+                          const void *data, int size)
+{
+    int nb, data_ofs = 0, row_size, flags, i, j, row, n = 0, start;
+    double vmag, ra, de, pra, pde, plx, epoch, pvo[2][3];
+    char ids[257], sp_type[33], otype[5];
     void *table_data;
-    star_t *s;
+    row_mag_t *rows;
+    star_data_t *d;
 
     // All the columns we care about in the source file.
+    enum { TYPE, GAIA, HIP, VMAG, GMAG, RA, DE, PLX, PRA, PDE, EPOC, BV, IDS,
+           SPEC };
     eph_table_column_t columns[] = {
-        {"type", 's', .size=4},
-        {"gaia", 'Q'},
-        {"hip",  'i'},
-        {"vmag", 'f', EPH_VMAG},
-        {"gmag", 'f', EPH_VMAG},
-        {"ra",   'f', EPH_RAD},
-        {"de",   'f', EPH_RAD},
-        {"plx",  'f', EPH_ARCSEC},
-        {"pra",  'f', EPH_RAD_PER_YEAR},
-        {"pde",  'f', EPH_RAD_PER_YEAR},
-        {"epoc", 'f', EPH_YEAR},
-        {"bv",   'f'},
-        {"ids",  's', .size=256},
-        {"spec", 's', .size=32},
+        [TYPE] = {"type", 's', .size=4},
+        [GAIA] = {"gaia", 'Q'},
+        [HIP]  = {"hip",  'i'},
+        [VMAG] = {"vmag", 'f', EPH_VMAG},
+        [GMAG] = {"gmag", 'f', EPH_VMAG},
+        [RA]   = {"ra",   'f', EPH_RAD},
+        [DE]   = {"de",   'f', EPH_RAD},
+        [PLX]  = {"plx",  'f', EPH_ARCSEC},
+        [PRA]  = {"pra",  'f', EPH_RAD_PER_YEAR},
+        [PDE]  = {"pde",  'f', EPH_RAD_PER_YEAR},
+        [EPOC] = {"epoc", 'f', EPH_YEAR},
+        [BV]   = {"bv",   'f'},
+        [IDS]  = {"ids",  's', .size=256},
+        [SPEC] = {"spec", 's', .size=32},
     };
+    eph_column_view_t v[ARRAY_SIZE(columns)];
 
-    *out = NULL;
-    // Only support STAR and GAIA chunks.  Ignore anything else.
-    if (strncmp(type, "STAR", 4) != 0 &&
-        strncmp(type, "GAIA", 4) != 0) return 0;
-
-    eph_read_tile_header(data, size, &data_ofs, &version, &order, &pix);
-    assert(version >= 3); // No more support for old style format.
     nb = eph_read_table_header(version, data, size,
                                &data_ofs, &row_size, &flags,
                                ARRAY_SIZE(columns), columns);
-    if (nb < 0) {
+    if (nb < 0 || columns[IDS].size >= sizeof(ids) ||
+                  columns[SPEC].size >= sizeof(sp_type)) {
         LOG_E("Cannot parse file");
         return -1;
     }
@@ -506,70 +710,249 @@ static int on_file_tile_loaded(const char type[4],
         LOG_E("Cannot get table data");
         return -1;
     }
-    data_ofs = 0;
-    if (flags & 1) eph_shuffle_bytes(table_data, row_size, nb);
-
-    tile = calloc(1, sizeof(*tile));
-    tile->sources = calloc(nb, sizeof(*tile->sources));
-    tile->mag_min = DBL_MAX;
-    tile->mag_max = -DBL_MAX;
-
-    for (i = 0; i < nb; i++) {
-        s = &tile->sources[tile->nb];
-        s->obj.ref = 1;
-        s->obj.klass = &star_klass;
-        eph_read_table_row(
-                table_data, size, &data_ofs, ARRAY_SIZE(columns), columns,
-                s->obj.type, &s->gaia, &s->hip, &vmag, &gmag,
-                &ra, &de, &plx, &pra, &pde, &epoch, &bv, ids, sp_type);
+    // Read the values directly from the table, without unshuffling it.
+    for (i = 0; i < ARRAY_SIZE(columns); i++)
+        eph_get_column_view(table_data, nb, flags, &columns[i], &v[i]);
+
+    // First only read the magnitudes, so that we can sort the rows and
+    // then fill the tile arrays in a single pass.
+    rows = malloc(nb * sizeof(*rows));
+    for (row = 0; row < nb; row++) {
+        vmag = v[VMAG].data ? eph_column_get_f(&v[VMAG], row) : NAN;
+        if (isnan(vmag)) vmag = eph_column_get_f(&v[GMAG], row);
+        assert(!isnan(vmag));
+        // Avoid overlapping stars from Gaia survey.
+        if (survey->is_gaia && vmag < survey->min_vmag) continue;
+        rows[n++] = (row_mag_t) {vmag, row};
+    }
+    // Sort the data by vmag, so that we can early exit during render.
+    qsort(rows, n, sizeof(*rows), row_mag_cmp);
+
+    start = tile->nb;
+    tile_grow(tile, n);
+
+    for (i = start; i < tile->nb; i++) {
+        row = rows[i - start].row;
+        vmag = rows[i - start].vmag;
+        d = &tile->data[i];
+        ra = eph_column_get_f(&v[RA], row);
+        de = eph_column_get_f(&v[DE], row);
+        plx = eph_column_get_f(&v[PLX], row);
+        pra = eph_column_get_f(&v[PRA], row);
+        pde = eph_column_get_f(&v[PDE], row);
+        epoch = eph_column_get_f(&v[EPOC], row);
         assert(!isnan(ra));
         assert(!isnan(de));
-        if (isnan(vmag)) vmag = gmag;
-        assert(!isnan(vmag));
 
         // Ignore plx values that are too low.  This is mostly because the
         // current data has some wrong values.
         if (!isnan(plx) && (plx < 2.0 / 1000)) plx = 0.0;
+        epoch = epoch ?: 2000; // Default epoch.
 
-        // Avoid overlapping stars from Gaia survey.
-        if (survey->is_gaia && vmag < survey->min_vmag) continue;
+        compute_pv(ra, de, pra, pde, plx, epoch, pvo, &d->distance);
+        vec3_copy(pvo[0], tile->pos[i]);
+        vec3_copy(pvo[1], tile->pm[i]);
+        tile->vmag[i] = vmag;
+        tile->bv[i] = eph_column_get_f(&v[BV], row);
+        tile->illuminances[i] = core_mag_to_illuminance(vmag);
 
-        if (!*s->obj.type) strncpy(s->obj.type, "*", 4); // Default type.
-        epoch = epoch ?: 2000; // Default epoch.
-        s->vmag = vmag;
-        s->plx = plx;
-        s->bv = bv;
+        d->gaia = eph_column_get_q(&v[GAIA], row);
+        d->hip = eph_column_get_i(&v[HIP], row);
+        d->plx = plx;
+        eph_column_get_s(&v[TYPE], row, otype);
+        if (!*otype) strncpy(otype, "*", sizeof(otype)); // Default type.
+        memcpy(d->type, otype, sizeof(d->type));
 
         // Turn '|' separated ids into '\0' separated values.
+        eph_column_get_s(&v[IDS], row, ids);
         if (*ids) {
-            s->names = calloc(1, 2 + strlen(ids));
+            d->names = calloc(1, 2 + strlen(ids));
             for (j = 0; ids[j]; j++)
-                s->names[j] = ids[j] != '|' ? ids[j] : '\0';
+                d->names[j] = ids[j] != '|' ? ids[j] : '\0';
         }
+        eph_column_get_s(&v[SPEC], row, sp_type);
         if (*sp_type) {
-            s->sp_type = strdup(sp_type);
+            d->sp_type = strdup(sp_type);
         }
 
         // If we didn't get any ids, but an HIP number, use it.
-        if (!s->names && s->hip) {
+        if (!d->names && d->hip) {
             // Add a log this this probably means a problem in the data.
-            if (s->vmag < 4) LOG_W_ONCE("HIP %d didn't have any ids", s->hip);
-            s->names = calloc(1, 16);
-            snprintf(s->names, 15, "HIP %d", s->hip);
+            if (vmag < 4) LOG_W_ONCE("HIP %d didn't have any ids", d->hip);
+            d->names = calloc(1, 16);
+            snprintf(d->names, 15, "HIP %d", d->hip);
         }
 
-        compute_pv(ra, de, pra, pde, plx, epoch, s);
-        s->illuminance = core_mag_to_illuminance(vmag);
-
-        tile->illuminance += s->illuminance;
+        tile->illuminance += tile->illuminances[i];
         tile->mag_min = fmin(tile->mag_min, vmag);
         tile->mag_max = fmax(tile->mag_max, vmag);
-        tile->nb++;
     }
-
-    // Sort the data by vmag, so that we can early exit during render.
-    qsort(tile->sources, tile->nb, sizeof(*tile->sources), star_data_cmp);
+    free(rows);
     free(table_data);
+    return n;
+}
+
+// Decode a chunk of a tile.  All the previous chunks should be decoded.
+static void tile_decode_chunk(tile_t *tile, const survey_t *survey,
+                              int version, const void *data, int size)
+{
+    tile_chunk_t *chunk = &tile->chunks[tile->nb_decoded];
+    assert(tile->nb_decoded < tile->nb_chunks);
+    chunk->start = tile->nb;
+    chunk->nb = tile_add_stars(tile, survey, version, data, size);
+    if (chunk->nb < 0) chunk->nb = 0;
+    tile->nb_decoded++;
+}
+
+// Decode the chunks of a tile decoder.  This runs in a thread, so it
+// should only touch the decoder tile.
+static int decode_chunks_worker(worker_t *worker)
+{
+    int i;
+    typeof(((tile_t*)0)->decoder) decoder = (void*)worker;
+    for (i = 0; i < decoder->nb_chunks; i++) {
+        // The pending chunks are always version 4.
+        tile_decode_chunk(decoder->tile, decoder->survey, 4,
+                          decoder->chunks[i].data, decoder->chunks[i].size);
+    }
+    return 0;
+}
+
+// Start to decode the next nb pending chunks of a tile.
+static void tile_decoder_start(tile_t *tile, const survey_t *survey, int nb)
+{
+    tile_t *part;
+
+    part = calloc(1, sizeof(*part));
+    part->mag_min = DBL_MAX;
+    part->mag_max = -DBL_MAX;
+    part->nb_chunks = nb;
+    part->chunks = calloc(nb, sizeof(*part->chunks));
+
+    tile->decoder = calloc(1, sizeof(*tile->decoder));
+    worker_init(&tile->decoder->worker, decode_chunks_worker);
+    tile->decoder->survey = survey;
+    tile->decoder->chunks = &tile->chunks[tile->nb_decoded];
+    tile->decoder->nb_chunks = nb;
+    tile->decoder->tile = part;
+}
+
+// Move the stars of a tile decoder at the end of the tile, once it is done.
+static void tile_decoder_done(tile_t *tile)
+{
+    int i, start = tile->nb;
+    tile_t *part = tile->decoder->tile;
+    tile_chunk_t *chunk;
+
+    tile_grow(tile, part->nb);
+    memcpy(tile->pos + start, part->pos, part->nb * sizeof(*tile->pos));
+    memcpy(tile->pm + start, part->pm, part->nb * sizeof(*tile->pm));
+    memcpy(tile->vmag + start, part->vmag, part->nb * sizeof(*tile->vmag));
+    memcpy(tile->bv + start, part->bv, part->nb * sizeof(*tile->bv));
+    memcpy(tile->illuminances + start, part->illuminances,
+           part->nb * sizeof(*tile->illuminances));
+    memcpy(tile->data + start, part->data, part->nb * sizeof(*tile->data));
+    tile->illuminance += part->illuminance;
+    tile->mag_min = fmin(tile->mag_min, part->mag_min);
+    tile->mag_max = fmax(tile->mag_max, part->mag_max);
+
+    for (i = 0; i < part->nb_decoded; i++) {
+        chunk = &tile->chunks[tile->nb_decoded++];
+        chunk->start = start + part->chunks[i].start;
+        chunk->nb = part->chunks[i].nb;
+        free(chunk->data);
+        chunk->data = NULL;
+        chunk->size = 0;
+    }
+
+    part->nb = 0; // The stars data now belongs to the tile.
+    del_tile(part);
+    free(tile->decoder);
+    tile->decoder = NULL;
+}
+
+// Check if all the stars of a tile brighter than a magnitude are decoded.
+static bool tile_is_decoded(const tile_t *tile, double max_mag)
+{
+    return tile->nb_decoded == tile->nb_chunks ||
+           tile->chunks[tile->nb_decoded].mag_min > max_mag;
+}
+
+/*
+ * Decode the chunks of a tile until we have all the stars brighter than
+ * a given magnitude.
+ *
+ * Unless sync is set, the chunks are decoded in a thread, and until this
+ * is done the tile only contains the stars decoded so far (see
+ * tile_is_decoded).
+ */
+static void tile_decode(tile_t *tile, const survey_t *survey, double max_mag,
+                        bool sync)
+{
+    int n;
+
+    while (true) {
+        if (tile->decoder) {
+            if (!worker_iter(&tile->decoder->worker)) {
+                if (!sync) return;
+                continue; // Wait for the thread.
+            }
+            tile_decoder_done(tile);
+        }
+        if (tile_is_decoded(tile, max_mag)) return;
+        for (n = tile->nb_decoded; n < tile->nb_chunks; n++) {
+            if (tile->chunks[n].mag_min > max_mag) break;
+        }
+        tile_decoder_start(tile, survey, n - tile->nb_decoded);
+    }
+}
+
+static int on_file_tile_loaded(const char type[4],
+                               const void *data, int size,
+                               const json_value *json,
+                               void *user)
+{
+    int version, data_ofs = 0, order, pix, children_mask;
+    double mag_min = -DBL_MAX, mag_max = DBL_MAX;
+    survey_t *survey = USER_GET(user, 0);
+    tile_t **out = USER_GET(user, 1); // Receive the tile.
+    int *transparency = USER_GET(user, 2);
+    tile_t *tile = *out;
+    tile_chunk_t *chunk;
+
+    // Only support STAR and GAIA chunks.  Ignore anything else.
+    if (strncmp(type, "STAR", 4) != 0 &&
+        strncmp(type, "GAIA", 4) != 0) return 0;
+
+    eph_read_tile_header(data, size, &data_ofs, &version, &order, &pix);
+    assert(version >= 3); // No more support for old style format.
+    if (version >= 4 &&
+        eph_read_mag_range(data, size, &data_ofs, &mag_min, &mag_max) != 0)
+        return -1;
+
+    if (!tile) {
+        tile = calloc(1, sizeof(*tile));
+        tile->mag_min = DBL_MAX;
+        tile->mag_max = -DBL_MAX;
+        *out = tile;
+    }
+    tile->chunks = realloc(tile->chunks,
+                           (tile->nb_chunks + 1) * sizeof(*tile->chunks));
+    chunk = &tile->chunks[tile->nb_chunks++];
+    *chunk = (tile_chunk_t) {mag_min, mag_max};
+
+    // Only decode the first chunk now.  The others are decoded when we
+    // need fainter stars (see get_tile).
+    if (version < 4 || tile->nb_decoded == tile->nb_chunks - 1) {
+        tile_decode_chunk(tile, survey, version, data + data_ofs,
+                          size - data_ofs);
+    } else {
+        chunk->size = size - data_ofs;
+        chunk->data = malloc(chunk->size);
+        memcpy(chunk->data, data + data_ofs, chunk->size);
+        tile->mag_min = fmin(tile->mag_min, mag_min);
+        tile->mag_max = fmax(tile->mag_max, mag_max);
+    }
 
     // If we have a json header, check for a children mask value.
     if (json) {
@@ -578,11 +961,21 @@ static int on_file_tile_loaded(const char type[4],
             *transparency = (~children_mask) & 15;
         }
     }
-
-    *out = tile;
     return 0;
 }
 
+static int tile_get_cost(const tile_t *tile)
+{
+    int i, ret;
+    ret = tile->nb * (sizeof(*tile->pos) + sizeof(*tile->pm) +
+                      sizeof(*tile->vmag) + sizeof(*tile->bv) +
+                      sizeof(*tile->illuminances) + sizeof(*tile->data) +
+                      sizeof(*tile->astrom));
+    for (i = tile->nb_decoded; i < tile->nb_chunks; i++)
+        ret += tile->chunks[i].size;
+    return ret;
+}
+
 static void *stars_create_tile(
         void *user, int order, int pix, const void *data, int size,
         int *cost, int *transparency)
@@ -591,8 +984,227 @@ static void *stars_create_tile(
     survey_t *survey = user;
     eph_load(data, size, USER_PASS(survey, &tile, transparency),
              on_file_tile_loaded);
-    if (tile) *cost = tile->nb * sizeof(*tile->sources);
+    if (tile) *cost = tile_get_cost(tile);
+    return tile;
+}
+
+/*
+ * Decoded tiles disk cache format (see hips_set_tile_cache_dir).
+ *
+ *   tile_header_t
+ *   pos, pm (double[nb][3])
+ *   vmag, bv, illuminances (float[nb]), padded to 8 bytes
+ *   star_record_t[nb]
+ *   names and sp_type strings of all the stars.
+ *   int32 number of chunks, int32 number of decoded chunks
+ *   chunk_record_t[nb_chunks]
+ *   data of the chunks not decoded yet.
+ *
+ * Change STARS_CACHE_VERSION when changing it.
+ */
+#define STARS_CACHE_VERSION 2
+
+typedef struct {
+    int32_t     nb;
+    int32_t     flags;
+    double      mag_min;
+    double      mag_max;
+    double      illuminance;
+} tile_header_t;
+
+typedef struct {
+    uint64_t    gaia;
+    double      distance;
+    int32_t     hip;
+    float       plx;
+    char        type[4] NONSTRING;
+    uint16_t    names_size;
+    uint16_t    sp_type_size;
+} star_record_t;
+
+typedef struct {
+    float       mag_min;
+    float       mag_max;
+    int32_t     start;
+    int32_t     nb;
+    int32_t     size;
+} chunk_record_t;
+
+// Return the size of a '\0' separated names list, including the final
+// extra '\0'.
+static int names_get_size(const char *names)
+{
+    const char *p = names;
+    if (!names) return 0;
+    while (*p) p += strlen(p) + 1;
+    return p - names + 1;
+}
+
+// Append size bytes to a buffer.
+static void write_bytes(UT_string *buf, const void *data, int size)
+{
+    utstring_bincpy(buf, data, size);
+}
+
+static void *stars_save_tile(void *user, const void *tile_, int *size)
+{
+    const tile_t *tile = tile_;
+    const int nb = tile->nb;
+    const uint64_t zero = 0;
+    const star_data_t *d;
+    tile_header_t header = {nb, tile->flags, tile->mag_min, tile->mag_max,
+                            tile->illuminance};
+    star_record_t rec;
+    chunk_record_t chunk;
+    UT_string buf;
+    int i;
+
+    utstring_init(&buf);
+    write_bytes(&buf, &header, sizeof(header));
+    write_bytes(&buf, tile->pos, nb * sizeof(*tile->pos));
+    write_bytes(&buf, tile->pm, nb * sizeof(*tile->pm));
+    write_bytes(&buf, tile->vmag, nb * sizeof(*tile->vmag));
+    write_bytes(&buf, tile->bv, nb * sizeof(*tile->bv));
+    write_bytes(&buf, tile->illuminances, nb * sizeof(*tile->illuminances));
+    write_bytes(&buf, &zero, (nb * 3 * sizeof(float)) % 8);
+    for (i = 0; i < nb; i++) {
+        d = &tile->data[i];
+        memset(&rec, 0, sizeof(rec));
+        rec.gaia = d->gaia;
+        rec.distance = d->distance;
+        rec.hip = d->hip;
+        rec.plx = d->plx;
+        memcpy(rec.type, d->type, sizeof(rec.type));
+        rec.names_size = names_get_size(d->names);
+        rec.sp_type_size = d->sp_type ? strlen(d->sp_type) + 1 : 0;
+        write_bytes(&buf, &rec, sizeof(rec));
+    }
+    for (i = 0; i < nb; i++) {
+        d = &tile->data[i];
+        if (d->names)
+            write_bytes(&buf, d->names, names_get_size(d->names));
+        if (d->sp_type)
+            write_bytes(&buf, d->sp_type, strlen(d->sp_type) + 1);
+    }
+    write_bytes(&buf, &tile->nb_chunks, 4);
+    write_bytes(&buf, &tile->nb_decoded, 4);
+    for (i = 0; i < tile->nb_chunks; i++) {
+        chunk = (chunk_record_t) {
+            tile->chunks[i].mag_min, tile->chunks[i].mag_max,
+            tile->chunks[i].start, tile->chunks[i].nb, tile->chunks[i].size};
+        write_bytes(&buf, &chunk, sizeof(chunk));
+    }
+    for (i = tile->nb_decoded; i < tile->nb_chunks; i++)
+        write_bytes(&buf, tile->chunks[i].data, tile->chunks[i].size);
+    *size = utstring_len(&buf);
+    return utstring_body(&buf);
+}
+
+// Copy size bytes from the cursor position and move it.
+static void read_bytes(const uint8_t **p, void *out, int size)
+{
+    memcpy(out, *p, size);
+    *p += size;
+}
+
+static void *stars_load_tile(void *user, int order, int pix,
+                             const void *data, int size, int *cost)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = (const uint8_t*)data + size;
+    const star_record_t *recs;
+    tile_header_t header;
+    chunk_record_t chunk;
+    tile_t *tile;
+    star_data_t *d;
+    int i, nb, nb_chunks, nb_decoded;
+
+    if (size < sizeof(header)) return NULL;
+    read_bytes(&p, &header, sizeof(header));
+    nb = header.nb;
+    if (nb < 0 || size < sizeof(header) +
+            nb * (6 * sizeof(double) + 3 * sizeof(float)) +
+            (nb * 3 * sizeof(float)) % 8 + nb * sizeof(star_record_t))
+        return NULL;
+
+    tile = calloc(1, sizeof(*tile));
+    tile->nb = nb;
+    tile->flags = header.flags;
+    tile->mag_min = header.mag_min;
+    tile->mag_max = header.mag_max;
+    tile->illuminance = header.illuminance;
+    tile->pos = malloc(nb * sizeof(*tile->pos));
+    tile->pm = malloc(nb * sizeof(*tile->pm));
+    tile->vmag = malloc(nb * sizeof(*tile->vmag));
+    tile->bv = malloc(nb * sizeof(*tile->bv));
+    tile->illuminances = malloc(nb * sizeof(*tile->illuminances));
+    tile->data = calloc(nb, sizeof(*tile->data));
+    read_bytes(&p, tile->pos, nb * sizeof(*tile->pos));
+    read_bytes(&p, tile->pm, nb * sizeof(*tile->pm));
+    read_bytes(&p, tile->vmag, nb * sizeof(*tile->vmag));
+    read_bytes(&p, tile->bv, nb * sizeof(*tile->bv));
+    read_bytes(&p, tile->illuminances, nb * sizeof(*tile->illuminances));
+    p += (nb * 3 * sizeof(float)) % 8;
+    recs = (const star_record_t*)p;
+    p += nb * sizeof(*recs);
+
+    for (i = 0; i < nb; i++) {
+        d = &tile->data[i];
+        d->gaia = recs[i].gaia;
+        d->distance = recs[i].distance;
+        d->hip = recs[i].hip;
+        d->plx = recs[i].plx;
+        memcpy(d->type, recs[i].type, sizeof(d->type));
+        if (p + recs[i].names_size + recs[i].sp_type_size > end)
+            goto error;
+        // Make sure the strings are terminated (see names_get_size).
+        if (recs[i].names_size && (p[recs[i].names_size - 1] ||
+                (recs[i].names_size > 1 && p[recs[i].names_size - 2])))
+            goto error;
+        if (recs[i].sp_type_size &&
+                p[recs[i].names_size + recs[i].sp_type_size - 1])
+            goto error;
+        if (recs[i].names_size) {
+            d->names = malloc(recs[i].names_size);
+            read_bytes(&p, d->names, recs[i].names_size);
+        }
+        if (recs[i].sp_type_size) {
+            d->sp_type = malloc(recs[i].sp_type_size);
+            read_bytes(&p, d->sp_type, recs[i].sp_type_size);
+        }
+    }
+
+    // Only set the tile chunks values once they are checked, since
+    // del_tile uses them.
+    if (p + 8 > end) goto error;
+    read_bytes(&p, &nb_chunks, 4);
+    read_bytes(&p, &nb_decoded, 4);
+    if (nb_chunks < 0 || nb_decoded < 0 || nb_decoded > nb_chunks ||
+        p + nb_chunks * sizeof(chunk) > end) goto error;
+    tile->chunks = calloc(nb_chunks, sizeof(*tile->chunks));
+    tile->nb_chunks = nb_chunks;
+    tile->nb_decoded = nb_decoded;
+    for (i = 0; i < tile->nb_chunks; i++) {
+        read_bytes(&p, &chunk, sizeof(chunk));
+        tile->chunks[i] = (tile_chunk_t) {chunk.mag_min, chunk.mag_max,
+                                          chunk.start, chunk.nb};
+        if (i < tile->nb_decoded && (chunk.start < 0 || chunk.nb < 0 ||
+                                     chunk.start + chunk.nb > nb))
+            goto error;
+        if (i >= tile->nb_decoded) tile->chunks[i].size = chunk.size;
+    }
+    for (i = tile->nb_decoded; i < tile->nb_chunks; i++) {
+        if (tile->chunks[i].size < 0 || p + tile->chunks[i].size > end)
+            goto error;
+        tile->chunks[i].data = malloc(tile->chunks[i].size);
+        read_bytes(&p, tile->chunks[i].data, tile->chunks[i].size);
+    }
+    *cost = tile_get_cost(tile);
     return tile;
+
+error:
+    del_tile(tile);
+    return NULL;
 }
 
 static int stars_init(obj_t *obj, json_value *args)
@@ -617,22 +1229,59 @@ static survey_t *get_survey(const stars_t *stars, const char *key)
     return NULL;
 }
 
+// Shift of the chunk index in the search index hints (see index_tile).
+#define HINT_CHUNK_SHIFT 48
+
+/*
+ * Add the names of the new decoded chunks of a tile to the search index.
+ *
+ * We use one hint per chunk: the tile nuniq, plus the chunk index in the
+ * high bits.
+ */
+static void index_tile(survey_t *survey, tile_t *tile, int order, int pix)
+{
+    int i;
+    const char *name;
+    const tile_chunk_t *chunk;
+    uint64_t hint;
+
+    for (; tile->nb_indexed < tile->nb_decoded; tile->nb_indexed++) {
+        chunk = &tile->chunks[tile->nb_indexed];
+        hint = pix_to_nuniq(order, pix) |
+               ((uint64_t)tile->nb_indexed << HINT_CHUNK_SHIFT);
+        if (search_index_has_hint(&g_stars->obj, survey->key, hint))
+            continue;
+        for (i = chunk->start; i < chunk->start + chunk->nb; i++) {
+            for (name = tile->data[i].names; name && *name;
+                 name += strlen(name) + 1)
+            {
+                search_index_add_hint(&g_stars->obj, survey->key, hint,
+                                      name, tile->vmag[i]);
+            }
+        }
+        // Mark the chunk as indexed even if it has no names.
+        search_index_add_hint(&g_stars->obj, survey->key, hint, NULL, NAN);
+    }
+}
+
 /*
  * Function: get_tile
  * Load and return a tile.
  *
  * Parameters:
- *   survey - The survey.
- *   order  - Healpix order.
- *   pix    - Healpix pix.
- *   sync   - If set, don't load in a thread.  This will block the main
- *            loop so should be avoided.
- *   code   - http return code (0 if still loading).
+ *   survey  - The survey.
+ *   order   - Healpix order.
+ *   pix     - Healpix pix.
+ *   max_mag - Decode all the stars up to this magnitude.  Unless sync is
+ *             set, this is done in a thread (see tile_is_decoded).
+ *   sync    - If set, don't load in a thread.  This will block the main
+ *             loop so should be avoided.
+ *   code    - http return code (0 if still loading).
  */
-static tile_t *get_tile(survey_t *survey, int order, int pix,
+static tile_t *get_tile(survey_t *survey, int order, int pix, double max_mag,
                         bool sync, int *code)
 {
-    int flags = 0;
+    int flags = 0, nb_decoded;
     tile_t *tile;
     assert(code);
     assert(survey);
@@ -642,6 +1291,12 @@ static tile_t *get_tile(survey_t *survey, int order, int pix,
         return NULL;
     }
     tile = hips_get_tile(survey->hips, order, pix, flags, code);
+    if (!tile) return NULL;
+    nb_decoded = tile->nb_decoded;
+    tile_decode(tile, survey, max_mag, sync);
+    if (tile->nb_decoded != nb_decoded)
+        hips_set_tile_cost(survey->hips, order, pix, tile_get_cost(tile));
+    index_tile(survey, tile, order, pix);
     return tile;
 }
 
@@ -653,13 +1308,13 @@ static int render_visitor(stars_t *stars, survey_t *survey,
 {
     painter_t painter = *painter_;
     tile_t *tile;
-    int i, n = 0, code;
+    int i, n = 0, nb, code;
     star_t *s;
-    double p_win[4], size = 0, luminance = 0, vmag = -DBL_MAX;
+    double size = 0, luminance = 0, vmag = -DBL_MAX;
     double color[3];
-    double v[3];
+    double (*astrom)[3], (*win_pos)[2], *p_win;
     double limit_mag = fmin(painter.stars_limit_mag, painter.hard_limit_mag);
-    bool selected;
+    bool selected, *visible;
 
     // Early exit if the tile is clipped.
     if (painter_is_healpix_clipped(&painter, FRAME_ASTROM, order, pix))
@@ -667,50 +1322,64 @@ static int render_visitor(stars_t *stars, survey_t *survey,
     if (order < survey->min_order) return 1;
 
     (*nb_tot)++;
-    tile = get_tile(survey, order, pix, false, &code);
+    tile = get_tile(survey, order, pix, limit_mag, false, &code);
     if (code) (*nb_loaded)++;
 
     if (!tile) goto end;
     if (tile->mag_min > limit_mag) goto end;
 
-    point_t *points = malloc(tile->nb * sizeof(*points));
-    for (i = 0; i < tile->nb; i++) {
-        s = &tile->sources[i];
-        if (s->vmag > limit_mag) break;
-
-        star_get_astrom(s, painter.obs, v);
-        if (!painter_project(&painter, FRAME_ASTROM, v, true, true, p_win))
-            continue;
+    // Number of stars bright enough to be rendered.
+    for (nb = 0; nb < tile->nb; nb++) {
+        if (tile->vmag[nb] > limit_mag) break;
+    }
+    astrom = tile_get_astrom_n(tile, painter.obs, nb);
+    win_pos = arena_alloc(painter.arena, nb * sizeof(*win_pos));
+    visible = arena_alloc(painter.arena, nb * sizeof(*visible));
+    if (!painter_project_n(&painter, FRAME_ASTROM, nb, astrom, true, true,
+                           win_pos, visible))
+        goto end;
+
+    point_t *points = arena_alloc(painter.arena, nb * sizeof(*points));
+    for (i = 0; i < nb; i++) {
+        if (!visible[i]) continue;
+        p_win = win_pos[i];
 
-        (*illuminance) += s->illuminance;
+        (*illuminance) += tile->illuminances[i];
 
         // No need to recompute the point size and luminance if the last
         // star had the same vmag (often the case since we sort by vmag).
-        if (s->vmag != vmag) {
-            vmag = s->vmag;
+        if (tile->vmag[i] != vmag) {
+            vmag = tile->vmag[i];
             core_get_point_for_mag(vmag, &size, &luminance);
         }
         if (size == 0.0 || luminance == 0.0)
             continue;
 
-        bv_to_rgb(isnan(s->bv) ? 0 : s->bv, color);
+        bv_to_rgb(isnan(tile->bv[i]) ? 0 : tile->bv[i], color);
         points[n] = (point_t) {
             .pos = {p_win[0], p_win[1]},
             .size = size,
             .color = {color[0] * 255, color[1] * 255, color[2] * 255,
                       luminance * 255},
             // This makes very faint stars not selectable
-            .obj = (luminance > 0.5 && size > 1) ? &s->obj : NULL,
+            .obj = (luminance > 0.5 && size > 1) ?
+                        &tile_get_star(tile, i)->obj : NULL,
         };
         n++;
-        selected = (&s->obj == core->selection);
-        if (selected || (stars->hints_visible && !survey->is_gaia))
-            star_render_name(&painter, s, FRAME_ASTROM, v, p_win, size, color);
+        selected = tile->stars && tile->stars[i] &&
+                   &tile->stars[i]->obj == core->selection;
+        if (!selected && (!stars->hints_visible || survey->is_gaia))
+            continue;
+        // Only create the star object if it can actually have a label.
+        if (!selected && vmag > get_hints_lim_mag(&painter, p_win))
+            continue;
+        s = tile_get_star(tile, i);
+        star_render_name(&painter, s, FRAME_ASTROM, astrom[i], p_win, size,
+                         color);
     }
     if (n > 0) {
         paint_2d_points(&painter, n, points);
     }
-    free(points);
 
 end:
     // Test if we should go into higher order tiles.
@@ -742,6 +1411,11 @@ static int stars_render(obj_t *obj, const painter_t *painter_)
                                &nb_tot, &nb_loaded, &illuminance);
             if (r == 1) hips_iter_push_children(&iter, order, pix);
         }
+        // Load the tiles ahead of the camera movements.
+        if (core->view_prediction.active) {
+            hips_prefetch(survey->hips, &painter, core->view_prediction.pos,
+                          core->view_prediction.fov);
+        }
     }
 
     /* Get the global stars luminance */
@@ -761,8 +1435,9 @@ static int stars_list(const obj_t *obj,
                       double max_mag, uint64_t hint, const char *source,
                       void *user, int (*f)(void *user, obj_t *obj))
 {
-    int order, pix, i, r, code;
+    int order, pix, i, r, code, c, ret = 0;
     tile_t *tile;
+    const tile_chunk_t *chunk;
     const stars_t *stars = (const stars_t*)obj;
     hips_iterator_t iter;
     survey_t *survey = NULL;
@@ -783,33 +1458,88 @@ static int stars_list(const obj_t *obj,
     if (!hint) {
         hips_iter_init(&iter);
         while (hips_iter_next(&iter, &order, &pix)) {
-            tile = get_tile(survey, order, pix, false, &code);
-            if (!tile || tile->mag_min >= max_mag) continue;
+            tile = get_tile(survey, order, pix, max_mag, false, &code);
+            if (!tile || !tile_is_decoded(tile, max_mag)) {
+                if (!code || tile) ret = MODULE_AGAIN;
+                continue;
+            }
+            if (tile->mag_min >= max_mag) continue;
             for (i = 0; i < tile->nb; i++) {
-                if (tile->sources[i].vmag > max_mag) continue;
-                r = f(user, &tile->sources[i].obj);
+                if (tile->vmag[i] > max_mag) continue;
+                r = f(user, &tile_get_star(tile, i)->obj);
                 if (r) break;
             }
             if (i < tile->nb) break;
             hips_iter_push_children(&iter, order, pix);
         }
-        return 0;
+        return ret;
     }
 
-    // Get tile from hint (as nuniq).
-    nuniq_to_pix(hint, &order, &pix);
-    tile = get_tile(survey, order, pix, false, &code);
+    // Get tile from hint (as nuniq, plus the chunk index), and only list
+    // the stars of the chunk.
+    nuniq_to_pix(hint & ((1ULL << HINT_CHUNK_SHIFT) - 1), &order, &pix);
+    tile = get_tile(survey, order, pix, -INFINITY, false, &code);
     if (!tile) {
         if (!code) return MODULE_AGAIN; // Try again later.
         return -1;
     }
-    for (i = 0; i < tile->nb; i++) {
-        r = f(user, &tile->sources[i].obj);
+    c = hint >> HINT_CHUNK_SHIFT;
+    if (c >= tile->nb_chunks) return -1;
+    get_tile(survey, order, pix, tile->chunks[c].mag_min, false, &code);
+    if (c >= tile->nb_decoded) return MODULE_AGAIN; // Still decoding.
+    chunk = &tile->chunks[c];
+    for (i = chunk->start; i < chunk->start + chunk->nb; i++) {
+        r = f(user, &tile_get_star(tile, i)->obj);
         if (r) break;
     }
     return 0;
 }
 
+static int stars_list_cone(const obj_t *obj, const double cap[4],
+                           double max_mag, void *user,
+                           int (*f)(void *user, obj_t *obj))
+{
+    int order, pix, i, n, code, ret = 0;
+    double tile_cap[4], (*astrom)[3];
+    const stars_t *stars = (const stars_t*)obj;
+    tile_t *tile;
+    hips_iterator_t iter;
+    survey_t *survey;
+
+    if (isnan(max_mag)) max_mag = DBL_MAX;
+    DL_FOREACH(stars->surveys, survey) {
+        if (max_mag < survey->min_vmag) continue;
+        hips_iter_init(&iter);
+        while (hips_iter_next(&iter, &order, &pix)) {
+            healpix_get_bounding_cap(1 << order, pix, tile_cap);
+            if (!cap_intersects_cap(cap, tile_cap)) continue;
+            if (order < survey->min_order) {
+                hips_iter_push_children(&iter, order, pix);
+                continue;
+            }
+            tile = get_tile(survey, order, pix, max_mag, false, &code);
+            if (!tile || !tile_is_decoded(tile, max_mag)) {
+                if (!code || tile) ret = MODULE_AGAIN;
+                continue;
+            }
+            // The stars are sorted by vmag.
+            for (n = 0; n < tile->nb; n++) {
+                if (tile->vmag[n] > max_mag) break;
+            }
+            astrom = tile_get_astrom_n(tile, core->observer, n);
+            for (i = 0; i < n; i++) {
+                if (!cap_contains_vec3(cap, astrom[i])) continue;
+                if (f(user, &tile_get_star(tile, i)->obj)) break;
+            }
+            if (i < n) return ret;
+            // Fainter stars are in the children tiles.
+            if (tile->mag_max > max_mag) continue;
+            hips_iter_push_children(&iter, order, pix);
+        }
+    }
+    return ret;
+}
+
 static int hips_property_handler(void* user, const char* section,
                                  const char* name, const char* value)
 {
@@ -823,6 +1553,19 @@ static json_value *hips_load_properties(const char *url, int *code)
     char path[1024];
     const char *data;
     json_value *ret;
+    hips_archive_t *archive;
+
+    if (hips_archive_is_archive(url)) {
+        archive = hips_archive_open(url);
+        data = archive ? hips_archive_get_file(archive, "properties", NULL)
+                       : NULL;
+        *code = data ? 200 : 404;
+        ret = data ? json_object_new(0) : NULL;
+        if (data) ini_parse_string(data, hips_property_handler, ret);
+        hips_archive_close(archive);
+        return ret;
+    }
+
     snprintf(path, sizeof(path), "%s/properties", url);
     data = asset_get_data(path, NULL, code);
     if (!data) return NULL;
@@ -864,6 +1607,9 @@ static int stars_add_data_source(obj_t *obj, const char *url, const char *key)
     hips_settings_t survey_settings = {
         .create_tile = stars_create_tile,
         .delete_tile = del_tile,
+        .save_tile = stars_save_tile,
+        .load_tile = stars_load_tile,
+        .cache_version = STARS_CACHE_VERSION,
     };
     int i, code;
     double release_date = 0;
@@ -894,9 +1640,13 @@ static int stars_add_data_source(obj_t *obj, const char *url, const char *key)
     survey_settings.user = survey;
     snprintf(survey->url, sizeof(survey->url), "%s", url);
     survey->hips = hips_create(survey->url, release_date, &survey_settings);
+    // The faint Gaia stars can wait for the other surveys tiles.
+    if (survey->is_gaia) survey->hips->fetch.bias = 1;
     survey->min_order = properties_get_f(args, "hips_order_min", 0);
     survey->max_vmag = properties_get_f(args, "max_vmag", NAN);
     survey->min_vmag = properties_get_f(args, "min_vmag", -2.0);
+    if (json_get_attr_s(args, "ids_index"))
+        survey->index_path = strdup(json_get_attr_s(args, "ids_index"));
 
     // Preload the first level of the survey (only for bright stars).
     if (survey->min_order == 0 && survey->min_vmag <= 0.0) {
@@ -924,33 +1674,171 @@ static int stars_add_data_source(obj_t *obj, const char *url, const char *key)
     return 0;
 }
 
-obj_t *obj_get_by_hip(int hip, int *code)
+/*
+ * Function: survey_get_index
+ * Return the ids index of a survey, loading it if needed.
+ *
+ * Parameters:
+ *   survey - A survey.
+ *   code   - 200 if the index is loaded, 0 if it is still loading, or 404 if
+ *            the survey has no index.
+ */
+static const stars_index_t *survey_get_index(survey_t *survey, int *code)
 {
-    int order, pix, i;
-    stars_t *stars = g_stars;
-    survey_t *survey;
+    char url[URL_MAX_SIZE];
+    const char *data;
+    int size;
+
+    *code = 404;
+    if (survey->index) {
+        *code = 200;
+        return survey->index;
+    }
+    if (!survey->index_path) return NULL;
+    if (survey->hips->archive) {
+        data = hips_archive_get_file(survey->hips->archive,
+                                     survey->index_path, &size);
+    } else {
+        snprintf(url, sizeof(url), "%s/%s", survey->url, survey->index_path);
+        data = asset_get_data2(url, ASSET_ACCEPT_404, &size, code);
+        if (!*code) return NULL; // Still loading.
+    }
+    if (data) survey->index = stars_index_open(data, size);
+    if (!survey->index) {
+        LOG_W("Cannot load stars index %s", survey->index_path);
+        free(survey->index_path);
+        survey->index_path = NULL;
+        *code = 404;
+        return NULL;
+    }
+    *code = 200;
+    return survey->index;
+}
+
+static bool star_data_has_id(const star_data_t *d, int type, uint64_t id)
+{
+    return type == STARS_INDEX_HIP ? d->hip == id : d->gaia == id;
+}
+
+// Return the row of a star in a tile, first trying the index row hint.
+static int tile_find_star(const tile_t *tile, int type, uint64_t id, int row)
+{
+    int i;
+    if (row >= 0 && row < tile->nb &&
+        star_data_has_id(&tile->data[row], type, id)) return row;
+    for (i = 0; i < tile->nb; i++) {
+        if (star_data_has_id(&tile->data[i], type, id)) return i;
+    }
+    return -1;
+}
+
+// Find a HIP star in a survey without index, using the precomputed
+// HIP -> healpix table.
+static obj_t *survey_get_by_hip(survey_t *survey, int hip, int *code)
+{
+    int order, pix, row;
     tile_t *tile;
 
+    *code = 404;
     for (order = 0; order < 2; order++) {
         pix = hip_get_pix(hip, order);
-        if (pix == -1) {
-            *code = 404;
-            return NULL;
-        }
-        for (survey = stars->surveys; survey; survey = survey->next) {
-            if (survey->is_gaia) continue;
-            tile = get_tile(survey, order, pix, true, code);
-            if (*code == 0) return NULL; // Still loading.
-            if (!tile) continue;
-            for (i = 0; i < tile->nb; i++) {
-                if (tile->sources[i].hip == hip) {
-                    return obj_retain(&tile->sources[i].obj);
+        if (pix == -1) return NULL;
+        tile = get_tile(survey, order, pix, INFINITY, true, code);
+        if (*code == 0) return NULL; // Still loading.
+        if (!tile) continue;
+        row = tile_find_star(tile, STARS_INDEX_HIP, hip, -1);
+        if (row != -1) return obj_retain(&tile_get_star(tile, row)->obj);
+    }
+    *code = 404;
+    return NULL;
+}
+
+/*
+ * Function: get_by_ids
+ * Find a list of stars from their HIP or Gaia ids.
+ *
+ * The positions of all the stars are first looked up in the surveys
+ * indexes, so that we only need to load the tiles containing the stars.
+ */
+static int get_by_ids(int type, int nb, const uint64_t *ids,
+                      obj_t **out, int *codes)
+{
+    int i, code, row, ret = 0;
+    survey_t *survey;
+    tile_t *tile;
+    const stars_index_t *index;
+    stars_index_pos_t *pos;
+
+    for (i = 0; i < nb; i++) {
+        out[i] = NULL;
+        codes[i] = 404;
+    }
+    pos = calloc(nb, sizeof(*pos));
+    DL_FOREACH(g_stars->surveys, survey) {
+        // The Gaia survey only contains faint stars without HIP number.
+        if (type == STARS_INDEX_HIP && survey->is_gaia) continue;
+        index = survey_get_index(survey, &code);
+        if (!index) {
+            for (i = 0; i < nb; i++) {
+                if (out[i]) continue;
+                if (code == 0) {
+                    codes[i] = 0; // Index still loading.
+                } else if (type == STARS_INDEX_HIP) {
+                    out[i] = survey_get_by_hip(survey, ids[i], &code);
+                    if (out[i] || codes[i] != 0) codes[i] = code;
+                    if (out[i]) ret++;
                 }
             }
+            continue;
+        }
+        stars_index_lookup(index, type, nb, ids, pos);
+        for (i = 0; i < nb; i++) {
+            if (out[i] || pos[i].order == -1) continue;
+            tile = get_tile(survey, pos[i].order, pos[i].pix, INFINITY,
+                            true, &code);
+            if (!tile) {
+                if (code == 0) codes[i] = 0;
+                continue;
+            }
+            row = tile_find_star(tile, type, ids[i], pos[i].row);
+            if (row == -1) continue;
+            out[i] = obj_retain(&tile_get_star(tile, row)->obj);
+            codes[i] = 200;
+            ret++;
         }
     }
-    *code = 404;
-    return NULL;
+    free(pos);
+    return ret;
+}
+
+obj_t *obj_get_by_hip(int hip, int *code)
+{
+    obj_t *ret;
+    uint64_t id = hip;
+    get_by_ids(STARS_INDEX_HIP, 1, &id, &ret, code);
+    return ret;
+}
+
+obj_t *obj_get_by_gaia(uint64_t gaia, int *code)
+{
+    obj_t *ret;
+    get_by_ids(STARS_INDEX_GAIA, 1, &gaia, &ret, code);
+    return ret;
+}
+
+int obj_get_by_hips(int nb, const int *hips, obj_t **out, int *codes)
+{
+    int i, ret;
+    uint64_t *ids = malloc(nb * sizeof(*ids));
+    for (i = 0; i < nb; i++) ids[i] = hips[i];
+    ret = get_by_ids(STARS_INDEX_HIP, nb, ids, out, codes);
+    free(ids);
+    return ret;
+}
+
+int obj_get_by_gaias(int nb, const uint64_t *gaias, obj_t **out, int *codes)
+{
+    return get_by_ids(STARS_INDEX_GAIA, nb, gaias, out, codes);
 }
 
 /*
@@ -975,6 +1863,7 @@ static obj_klass_t stars_klass = {
     .init           = stars_init,
     .render         = stars_render,
     .list           = stars_list,
+    .list_cone      = stars_list_cone,
     .add_data_source = stars_add_data_source,
     .render_order   = 20,
     .attributes = (attribute_t[]) {
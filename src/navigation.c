@@ -176,6 +176,50 @@ void core_update_fov(double dt)
 }
 
 
+void core_update_view_prediction(double dt)
+{
+    typeof(core->view_prediction) *pred = &core->view_prediction;
+    const observer_t *obs = core->observer;
+    // How far in the future we extrapolate the current movement (sec).
+    const double LOOKAHEAD = 0.5;
+    // Min angular speed to consider the view as moving (rad/sec).
+    const double MIN_SPEED = 1.0 * DD2R;
+    double v[4] = {1, 0, 0, 0}, yaw, pitch, k, speed;
+
+    // Smoothed velocities, to ignore the noise of the touch events.
+    // No velocity at the first call.
+    k = pred->fov_log ? fmin(dt / 0.1, 1.0) : 0.0;
+    pred->v_yaw = mix(pred->v_yaw, eraAnpm(obs->yaw - pred->yaw) / dt, k);
+    pred->v_pitch = mix(pred->v_pitch, (obs->pitch - pred->pitch) / dt, k);
+    pred->v_fov_log = mix(pred->v_fov_log,
+                          (log(core->fov) - pred->fov_log) / dt, k);
+    pred->yaw = obs->yaw;
+    pred->pitch = obs->pitch;
+    pred->fov_log = log(core->fov);
+
+    if (core->target.src_time && !core->target.lock) {
+        quat_mul_vec3(core->target.dst_q, v, v);
+        vec3_copy(v, pred->pos);
+        pred->active = true;
+    } else {
+        speed = sqrt(pow(pred->v_yaw * cos(obs->pitch), 2) +
+                     pow(pred->v_pitch, 2));
+        yaw = obs->yaw + pred->v_yaw * LOOKAHEAD;
+        pitch = clamp(obs->pitch + pred->v_pitch * LOOKAHEAD,
+                      -M_PI / 2, M_PI / 2);
+        vec3_from_sphe(yaw, pitch, pred->pos);
+        pred->active = speed > MIN_SPEED ||
+                       fabs(pred->v_fov_log) * LOOKAHEAD > 0.1;
+    }
+
+    if (core->fov_animation.src_time && core->fov_animation.dst_fov) {
+        pred->fov = core->fov_animation.dst_fov;
+        pred->active = true;
+    } else {
+        pred->fov = exp(pred->fov_log + pred->v_fov_log * LOOKAHEAD);
+    }
+}
+
 // Weak so that we can easily replace the navigation algorithm.
 __attribute__((weak))
 void core_update_observer(double dt)
@@ -184,4 +228,5 @@ void core_update_observer(double dt)
     core_update_time(dt);
     core_update_direction(dt);
     core_update_mount(dt);
+    core_update_view_prediction(dt);
 }
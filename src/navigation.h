@@ -22,3 +22,13 @@
  * Should be called at each frame.
  */
 void core_update_observer(double dt);
+
+/*
+ * Function: core_update_view_prediction
+ * Update the guess of where the view will be in the near future.
+ *
+ * If a direction or fov animation is running we use its target, otherwise
+ * we extrapolate the current yaw, pitch and fov velocities.  The result is
+ * stored in core->view_prediction.
+ */
+void core_update_view_prediction(double dt);
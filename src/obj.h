@@ -154,6 +154,13 @@ struct obj_klass
                 uint64_t hint, const char *source, void *user,
                 int (*f)(void *user, obj_t *obj));
 
+    // List the sky objects children that might be inside a cone of the sky
+    // (see core_query_cone).  The cap is in the astrometric frame and
+    // already includes a margin, so the method can be approximate.  Return
+    // MODULE_AGAIN if some data is still loading.
+    int (*list_cone)(const obj_t *obj, const double cap[4], double max_mag,
+                     void *user, int (*f)(void *user, obj_t *obj));
+
     // Add a source of data.
     int (*add_data_source)(obj_t *obj, const char *url, const char *key);
 
@@ -125,6 +125,39 @@ void painter_update_clip_info(painter_t *painter)
     }
 }
 
+// Max order of the visible healpix sets.
+#define HEALPIX_CACHE_MAX_ORDER 9
+
+// Max order for which we remember the clipping test result of each cell.
+#define HEALPIX_CACHE_MAX_MEMO_ORDER 6
+
+/*
+ * Type: healpix_set_t
+ * Visible healpix cells of a given frame.
+ *
+ * We remember the result of the clipping test of each cell up to
+ * HEALPIX_CACHE_MAX_MEMO_ORDER, and the lists of visible cells for each
+ * order up to HEALPIX_CACHE_MAX_ORDER.  All allocated on demand.
+ */
+typedef struct {
+    // Clip test result for each cell: 0: unknown, 1: visible, 2: clipped.
+    uint8_t *state[HEALPIX_CACHE_MAX_MEMO_ORDER + 1];
+    // Sorted lists of visible cells, or NULL if not computed yet.
+    int nb[HEALPIX_CACHE_MAX_ORDER + 1];
+    int *pix[HEALPIX_CACHE_MAX_ORDER + 1];
+} healpix_set_t;
+
+/*
+ * Type: healpix_cache_t
+ * Sets of visible healpix cells for each frame.
+ *
+ * Since the clipping also depends on the PAINTER_HIDE_BELOW_HORIZON flag,
+ * we keep one set for each value.
+ */
+struct healpix_cache {
+    healpix_set_t sets[FRAMES_NB][2];
+};
+
 int paint_prepare(painter_t *painter, double win_w, double win_h,
                   double scale)
 {
@@ -134,6 +167,9 @@ int paint_prepare(painter_t *painter, double win_w, double win_h,
     for (i = 0; i < ARRAY_SIZE(painter->textures); i++)
         mat3_set_identity(painter->textures[i].mat);
     areas_clear_all(core->areas);
+    painter->arena = render_get_arena(painter->rend);
+    painter->healpix_cache = arena_calloc(painter->arena, 1,
+                                          sizeof(*painter->healpix_cache));
 
     cull_flipped = (bool)(painter->proj->flags & PROJ_FLIP_HORIZONTAL) !=
                    (bool)(painter->proj->flags & PROJ_FLIP_VERTICAL);
@@ -601,7 +637,7 @@ static bool painter_is_planet_quad_clipped(const painter_t *painter, int frame,
     return false;
 }
 
-bool painter_is_healpix_clipped(const painter_t *painter, int frame,
+static bool is_healpix_clipped_(const painter_t *painter, int frame,
                                 int order, int pix)
 {
     uv_map_t map;
@@ -609,6 +645,73 @@ bool painter_is_healpix_clipped(const painter_t *painter, int frame,
     return painter_is_quad_clipped(painter, frame, &map);
 }
 
+// Get the cache set for a given frame, or NULL.
+static healpix_set_t *get_healpix_set(const painter_t *painter, int frame)
+{
+    if (!painter->healpix_cache) return NULL;
+    return &painter->healpix_cache->sets[frame]
+                [(painter->flags & PAINTER_HIDE_BELOW_HORIZON) ? 1 : 0];
+}
+
+bool painter_is_healpix_clipped(const painter_t *painter, int frame,
+                                int order, int pix)
+{
+    healpix_set_t *set;
+    uint8_t *state = NULL;
+    bool ret = false;
+    int o;
+
+    set = get_healpix_set(painter, frame);
+    if (!set) return is_healpix_clipped_(painter, frame, order, pix);
+
+    if (order <= HEALPIX_CACHE_MAX_MEMO_ORDER) {
+        if (!set->state[order]) {
+            set->state[order] = arena_calloc(painter->arena,
+                                             12 << (2 * order), 1);
+        }
+        state = &set->state[order][pix];
+        if (*state) return *state == 2;
+    }
+
+    // If a parent is clipped, so is the cell.  Only look at the parents
+    // we remember, so that we never test the same cell twice.
+    if (order > 0) {
+        o = fmin(order - 1, HEALPIX_CACHE_MAX_MEMO_ORDER);
+        ret = painter_is_healpix_clipped(painter, frame, o,
+                                         pix >> (2 * (order - o)));
+    }
+    ret = ret || is_healpix_clipped_(painter, frame, order, pix);
+    if (state) *state = ret ? 2 : 1;
+    return ret;
+}
+
+int painter_get_visible_healpix(const painter_t *painter, int frame,
+                                int order, const int **pix)
+{
+    healpix_set_t *set;
+    const int *parents;
+    int i, nb, p;
+
+    set = get_healpix_set(painter, frame);
+    if (!set || order > HEALPIX_CACHE_MAX_ORDER) return -1;
+
+    if (!set->pix[order]) {
+        nb = (order == 0) ? 12 :
+             4 * painter_get_visible_healpix(painter, frame, order - 1,
+                                             &parents);
+        set->pix[order] = arena_alloc(painter->arena,
+                                      nb * sizeof(*set->pix[order]));
+        for (i = 0; i < nb; i++) {
+            p = (order == 0) ? i : parents[i / 4] * 4 + i % 4;
+            if (painter_is_healpix_clipped(painter, frame, order, p))
+                continue;
+            set->pix[order][set->nb[order]++] = p;
+        }
+    }
+    *pix = set->pix[order];
+    return set->nb[order];
+}
+
 bool painter_is_planet_healpix_clipped(const painter_t *painter,
                                        const double transf[4][4],
                                        int order, int pix)
@@ -966,6 +1069,38 @@ bool painter_project(const painter_t *painter, int frame,
     return is_visible_win(v, painter->proj->window_size);
 }
 
+int painter_project_n(const painter_t *painter, int frame, int n,
+                      const double (*pos)[3], bool at_inf, bool clip_first,
+                      double (*win_pos)[2], bool *visible)
+{
+    int i, j, nb = 0, ret = 0;
+    double (*v)[3];
+    int *idx;
+
+    v = arena_alloc(painter->arena, n * sizeof(*v));
+    idx = arena_alloc(painter->arena, n * sizeof(*idx));
+
+    // Only keep the points that pass the fast clipping test, so that the
+    // projection kernel runs on contiguous data.
+    for (i = 0; i < n; i++) {
+        visible[i] = false;
+        if (clip_first &&
+                painter_is_point_clipped_fast(painter, frame, pos[i], at_inf))
+            continue;
+        convert_frame(painter->obs, frame, FRAME_VIEW, at_inf, pos[i], v[nb]);
+        idx[nb++] = i;
+    }
+
+    project_to_win_n(painter->proj, nb, v, v);
+    for (j = 0; j < nb; j++) {
+        i = idx[j];
+        vec2_copy(v[j], win_pos[i]);
+        visible[i] = is_visible_win(v[j], painter->proj->window_size);
+        ret += visible[i];
+    }
+    return ret;
+}
+
 bool painter_unproject(const painter_t *painter, int frame,
                      const double win_pos[2], double pos[3]) {
     double p[4] = {win_pos[0], win_pos[1], 0};
@@ -24,6 +24,8 @@ typedef struct point point_t;
 typedef struct point_3d point_3d_t;
 typedef struct texture texture_t;
 typedef struct renderer renderer_t;
+typedef struct arena arena_t;
+typedef struct healpix_cache healpix_cache_t;
 
 // Base font size in pixels
 #define FONT_SIZE_BASE 15
@@ -110,6 +112,11 @@ enum {
 struct painter
 {
     renderer_t      *rend;          // The render used.
+    // Per frame memory, only valid until paint_finish.
+    arena_t         *arena;
+    // Per frame sets of visible healpix cells, shared by all the modules.
+    // See <painter_get_visible_healpix>.  Can be NULL.
+    healpix_cache_t *healpix_cache;
     const observer_t *obs;
 
     const projection_t *proj;          // Project from view to NDC.
@@ -386,9 +393,34 @@ bool painter_is_quad_clipped(const painter_t *painter, int frame,
 //  A clipped tile is guaranteed to be not visible, but it is not guaranteed
 //  that a non visible tile is clipped.  So this function can return false
 //  even though a tile is not actually visible.
+//
+//  The result is looked up in the per frame visible cells set when
+//  possible, see <painter_get_visible_healpix>.
 bool painter_is_healpix_clipped(const painter_t *painter, int frame,
                                 int order, int pix);
 
+/*
+ * Function: painter_get_visible_healpix
+ * Get all the healpix cells of a given order that are not clipped.
+ *
+ * The sets are computed once per frame, for each frame type and order, and
+ * shared by all the modules, so that we don't test the same cells again
+ * and again.  Each order is computed from the visible cells of the
+ * previous one.
+ *
+ * Parameters:
+ *   painter    - The painter.
+ *   frame      - One of the <FRAME> enum frame.
+ *   order      - Healpix order.
+ *   pix        - Get a pointer to the sorted list of visible pix.  Only
+ *                valid until the end of the frame.
+ *
+ * Returns:
+ *   The number of visible cells, or -1 if the painter has no cache.
+ */
+int painter_get_visible_healpix(const painter_t *painter, int frame,
+                                int order, const int **pix);
+
 /*
  * Function: painter_is_planet_healpix_clipped
  * Check if a healpix pixel on the surface of a planet is clipped.
@@ -614,6 +646,28 @@ void painter_project_ellipse(const painter_t *painter, int frame,
 bool painter_project(const painter_t *painter, int frame, const double pos[3],
                      bool at_inf, bool clip_first, double win_pos[2]);
 
+/*
+ * Function: painter_project_n
+ * Batch version of <painter_project>.
+ *
+ * Parameters:
+ *   painter    - The painter.
+ *   frame      - The frame in which the points are defined.
+ *   n          - Number of points.
+ *   pos        - The points 3D coordinates.
+ *   at_inf     - true for fixed objects (far away from the solar system).
+ *   clip_first - Skip the projection of the points identified as clipped.
+ *                Their win_pos content is then undefined.
+ *   win_pos    - The points positions in screen coordinates (px).
+ *   visible    - Set to false for the clipped points, true otherwise.
+ *
+ * Returns:
+ *   The number of visible points.
+ */
+int painter_project_n(const painter_t *painter, int frame, int n,
+                      const double (*pos)[3], bool at_inf, bool clip_first,
+                      double (*win_pos)[2], bool *visible);
+
 
 /*
  * Function: painter_unproject
@@ -73,6 +73,40 @@ bool project_to_win(const projection_t *proj, const double input[3],
     return true;
 }
 
+void project_to_win_n(const projection_t *proj, int n,
+                      const double (*input)[3], double (*out)[3])
+{
+    int i;
+    double x, y, z, w;
+    const double (*m)[4] = (const double (*)[4])proj->mat;
+
+    if (proj->klass->project_n) {
+        proj->klass->project_n(n, input, out);
+    } else {
+        for (i = 0; i < n; i++) proj->klass->project(input[i], out[i]);
+    }
+
+    // Same as mat4_mul_vec4 with w = 1, and the conversion to window
+    // coordinates.
+    for (i = 0; i < n; i++) {
+        x = out[i][0];
+        y = out[i][1];
+        z = out[i][2];
+        w = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3];
+        if (!w) {
+            out[i][0] = out[i][1] = out[i][2] = NAN;
+            continue;
+        }
+        w = 1.0 / w;
+        out[i][0] = (m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0]) * w;
+        out[i][1] = (m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1]) * w;
+        out[i][2] = (m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2]) * w;
+        out[i][0] = (+out[i][0] + 1) / 2 * proj->window_size[0];
+        out[i][1] = (-out[i][1] + 1) / 2 * proj->window_size[1];
+        out[i][2] = (out[i][2] + 1) / 2;
+    }
+}
+
 bool project_to_win_xy(const projection_t *proj, const double input[3],
                        double out[2])
 {
@@ -96,3 +130,43 @@ bool unproject(const projection_t *proj,
     mat4_mul_vec4(inv, p, p);
     return proj->klass->backward(p, out);
 }
+
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include <stdlib.h>
+
+// Check that project_to_win_n gives the same results as project_to_win.
+static void test_project_n(void)
+{
+    const int n = 1000;
+    int type, i, j;
+    projection_t proj;
+    double (*v)[3], (*out)[3], p[3];
+
+    v = calloc(n, sizeof(*v));
+    out = calloc(n, sizeof(*out));
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 3; j++) v[i][j] = (double)rand() / RAND_MAX * 2 - 1;
+    }
+    for (type = PROJ_PERSPECTIVE; type < PROJ_COUNT; type++) {
+        projection_init(&proj, type, 60 * DD2R, 800, 600);
+        project_to_win_n(&proj, n, v, out);
+        for (i = 0; i < n; i++) {
+            if (!project_to_win(&proj, v[i], p)) {
+                assert(isnan(out[i][0]));
+                continue;
+            }
+            for (j = 0; j < 3; j++)
+                assert(fabs(p[j] - out[i][j]) <= 1e-9 * fmax(1, fabs(p[j])));
+        }
+    }
+    free(v);
+    free(out);
+}
+
+TEST_REGISTER(NULL, test_project_n, TEST_AUTO);
+
+#endif
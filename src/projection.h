@@ -80,6 +80,11 @@ struct projection_klass
      * by the projection 4x4 matrix to get the clipping space coordinates.
      */
     bool (*project)(const double v[S 3], double out[S 3]);
+    /*
+     * Optional batch version of project, used by project_to_win_n.  The
+     * input and output arrays can be the same.
+     */
+    void (*project_n)(int n, const double (*v)[3], double (*out)[3]);
     bool (*backward)(const double v[S 3], double out[S 3]);
     void (*compute_fovs)(int proj_type, double fov, double aspect,
                          double *fovx, double *fovy);
@@ -141,6 +146,21 @@ bool project_to_win(const projection_t *proj, const double input[S 3],
  */
 bool project_to_win_xy(const projection_t *proj, const double input[S 3],
                        double out[S 2]);
+/*
+ * Function: project_to_win_n
+ * Batch version of project_to_win.
+ *
+ * Parameters:
+ *   proj   - A projection.
+ *   n      - Number of points.
+ *   input  - Input xyz coordinates, in view space.
+ *   out    - Output xyz coordinates in window space.  Can be the same
+ *            array as input.  The points that cannot be projected are set
+ *            to NAN.
+ */
+void project_to_win_n(const projection_t *proj, int n,
+                      const double (*input)[3], double (*out)[3]);
+
 /*
  * Function: project_to_clip
  * Project from view coordinates to clip space.
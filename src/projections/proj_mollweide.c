@@ -52,6 +52,14 @@ static double clamp(double x, double a, double b)
     return x < a ? a : x > b ? b : x;
 }
 
+// No closed form to vectorize, but this avoids an indirect call per point.
+static void proj_mollweide_project_n(int n, const double (*v)[3],
+                                     double (*out)[3])
+{
+    int i;
+    for (i = 0; i < n; i++) proj_mollweide_project(v[i], out[i]);
+}
+
 static bool proj_mollweide_backward(const double v[3], double out[3])
 {
     double x, y, theta, phi, lambda, cp;
@@ -103,6 +111,7 @@ static const projection_klass_t proj_mollweide_klass = {
     .max_ui_fov             = 360 * DD2R,
     .init                   = proj_mollweide_init,
     .project                = proj_mollweide_project,
+    .project_n              = proj_mollweide_project_n,
     .backward               = proj_mollweide_backward,
     .compute_fovs           = proj_mollweide_compute_fov,
 };
@@ -10,6 +10,8 @@
 #include "projection.h"
 #include "utils/vec.h"
 
+#include <string.h>
+
 /* Degrees to radians */
 #define DD2R (1.745329251994329576923691e-2)
 /* Radians to degrees */
@@ -23,6 +25,12 @@ static bool proj_perspective_project(const double v[3], double out[3])
     return true;
 }
 
+static void proj_perspective_project_n(int n, const double (*v)[3],
+                                       double (*out)[3])
+{
+    if (v != out) memcpy(out, v, n * sizeof(*out));
+}
+
 static bool proj_perspective_backward(const double v[3], double out[3])
 {
     vec3_copy(v, out);
@@ -54,6 +62,7 @@ static const projection_klass_t proj_perspective_klass = {
     .max_ui_fov     = 120. * DD2R,
     .init           = proj_perspective_init,
     .project        = proj_perspective_project,
+    .project_n      = proj_perspective_project_n,
     .backward       = proj_perspective_backward,
     .compute_fovs   = proj_perspective_compute_fov,
 };
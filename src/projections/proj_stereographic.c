@@ -57,6 +57,29 @@ static bool proj_stereographic_project(const double v[3], double out[3])
     return true;
 }
 
+static void proj_stereographic_project_n(int n, const double (*v)[3],
+                                         double (*out)[3])
+{
+    int i;
+    double x, y, z, d, k;
+    for (i = 0; i < n; i++) {
+        x = v[i][0];
+        y = v[i][1];
+        z = v[i][2];
+        d = sqrt(x * x + y * y + z * z);
+        // Discountinuity case.
+        if (z == d) {
+            out[i][0] = out[i][1] = out[i][2] = 0;
+            continue;
+        }
+        // Same as proj_stereographic_project, simplified.
+        k = 2 * d / (d - z);
+        out[i][0] = x * k;
+        out[i][1] = y * k;
+        out[i][2] = -d;
+    }
+}
+
 static bool proj_stereographic_backward(const double v[3], double out[3])
 {
     double lqq;
@@ -94,6 +117,7 @@ static const projection_klass_t proj_stereographic_klass = {
     .max_ui_fov     = 185. * DD2R,
     .init           = proj_stereographic_init,
     .project        = proj_stereographic_project,
+    .project_n      = proj_stereographic_project_n,
     .backward       = proj_stereographic_backward,
     .compute_fovs   = proj_stereographic_compute_fov,
 };
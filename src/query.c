@@ -0,0 +1,296 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+
+// Healpix order of the grid used for the modules without list_cone method.
+#define GRID_ORDER 2
+#define GRID_NSIDE (1 << GRID_ORDER)
+#define GRID_NPIX (12 * GRID_NSIDE * GRID_NSIDE)
+
+// Margin added to the cone passed to the list_cone methods, to cover the
+// difference between the astrometric and apparent directions (aberration,
+// light deflection).
+#define LIST_CONE_MARGIN (1.0 / 60 * DD2R)
+
+// An object in a module grid.
+typedef struct {
+    obj_t   *obj;
+    double  pos[3]; // Apparent ICRF direction.
+    double  vmag;
+    int     pix;
+} item_t;
+
+/*
+ * Type: grid_t
+ * Objects of a module sorted by healpix pixel.
+ *
+ * We recompute the grid when the observer or the module children change.
+ */
+typedef struct {
+    UT_hash_handle  hh;
+    const obj_t     *module;
+    uint64_t        obs_hash;
+    int             nb_children;
+    int             nb;
+    int             allocated;
+    item_t          *items;
+    int             offsets[GRID_NPIX + 1]; // Index of each pixel items.
+} grid_t;
+
+typedef struct {
+    obj_t   *obj;
+    double  vmag;
+} result_t;
+
+// Data of a query.
+typedef struct {
+    double      cap[4];  // The cone in the ICRF frame.
+    double      max_vmag;
+    const char  *filter;
+    result_t    *results;
+    int         nb;
+    int         allocated;
+} query_t;
+
+static struct {
+    grid_t      *grids;
+    double      pix_caps[GRID_NPIX][4];
+    bool        pix_caps_init;
+} g_query = {};
+
+static void add_result(query_t *query, obj_t *obj, double vmag)
+{
+    if (query->nb >= query->allocated) {
+        query->allocated = query->allocated ? query->allocated * 2 : 64;
+        query->results = realloc(query->results,
+                                 query->allocated * sizeof(*query->results));
+    }
+    query->results[query->nb++] = (result_t) {obj_retain(obj), vmag};
+}
+
+static bool match_filter(const query_t *query, const obj_t *obj, double vmag)
+{
+    if (!isnan(query->max_vmag) && !isnan(vmag) && vmag > query->max_vmag)
+        return false;
+    if (query->filter && !otype_match(obj->type, query->filter))
+        return false;
+    return true;
+}
+
+static bool get_pos(const obj_t *obj, double pos[3], double *vmag)
+{
+    double pvo[2][4];
+    if (obj_get_pvo(obj, core->observer, pvo) != 0) return false;
+    vec3_normalize(pvo[0], pos);
+    if (obj_get_info(obj, core->observer, INFO_VMAG, vmag) != 0)
+        *vmag = NAN;
+    return true;
+}
+
+// Exact test of the objects returned by the list_cone methods.
+static int on_cone_obj(void *user, obj_t *obj)
+{
+    query_t *query = user;
+    double pos[3], vmag;
+    if (!get_pos(obj, pos, &vmag)) return 0;
+    if (!cap_contains_vec3(query->cap, pos)) return 0;
+    if (!match_filter(query, obj, vmag)) return 0;
+    add_result(query, obj, vmag);
+    return 0;
+}
+
+static int on_grid_obj(void *user, obj_t *obj)
+{
+    grid_t *grid = user;
+    item_t item = {};
+    if (!get_pos(obj, item.pos, &item.vmag)) return 0;
+    item.obj = obj_retain(obj);
+    item.pix = healpix_vec2pix(GRID_NSIDE, item.pos);
+    if (grid->nb >= grid->allocated) {
+        grid->allocated = grid->allocated ? grid->allocated * 2 : 64;
+        grid->items = realloc(grid->items,
+                              grid->allocated * sizeof(*grid->items));
+    }
+    grid->items[grid->nb++] = item;
+    return 0;
+}
+
+static int item_cmp(const void *a, const void *b)
+{
+    return cmp(((const item_t*)a)->pix, ((const item_t*)b)->pix);
+}
+
+static void grid_clear(grid_t *grid)
+{
+    int i;
+    for (i = 0; i < grid->nb; i++) obj_release(grid->items[i].obj);
+    free(grid->items);
+    grid->items = NULL;
+    grid->nb = 0;
+    grid->allocated = 0;
+}
+
+// Return the grid of a module, recomputing it if needed.
+static grid_t *get_grid(const obj_t *module)
+{
+    grid_t *grid;
+    int i, pix, nb_children;
+    obj_t *child;
+
+    DL_COUNT(module->children, child, nb_children);
+    HASH_FIND_PTR(g_query.grids, &module, grid);
+    if (!grid) {
+        grid = calloc(1, sizeof(*grid));
+        grid->module = module;
+        grid->obs_hash = ~core->observer->hash; // Force update.
+        HASH_ADD_PTR(g_query.grids, module, grid);
+    }
+    if (grid->obs_hash == core->observer->hash &&
+        grid->nb_children == nb_children) return grid;
+
+    grid_clear(grid);
+    grid->obs_hash = core->observer->hash;
+    grid->nb_children = nb_children;
+    module_list_objs(module, NAN, 0, NULL, grid, on_grid_obj);
+    qsort(grid->items, grid->nb, sizeof(*grid->items), item_cmp);
+    for (i = 0, pix = 0; pix <= GRID_NPIX; pix++) {
+        while (i < grid->nb && grid->items[i].pix < pix) i++;
+        grid->offsets[pix] = i;
+    }
+    return grid;
+}
+
+static void query_grid(query_t *query, const obj_t *module)
+{
+    int pix, i;
+    const grid_t *grid = get_grid(module);
+    const item_t *item;
+
+    for (pix = 0; pix < GRID_NPIX; pix++) {
+        if (grid->offsets[pix] == grid->offsets[pix + 1]) continue;
+        if (!cap_intersects_cap(query->cap, g_query.pix_caps[pix])) continue;
+        for (i = grid->offsets[pix]; i < grid->offsets[pix + 1]; i++) {
+            item = &grid->items[i];
+            if (!cap_contains_vec3(query->cap, item->pos)) continue;
+            if (!match_filter(query, item->obj, item->vmag)) continue;
+            add_result(query, item->obj, item->vmag);
+        }
+    }
+}
+
+static int result_cmp(const void *a_, const void *b_)
+{
+    const result_t *a = a_, *b = b_;
+    // Objects without magnitude last.
+    if (isnan(a->vmag) || isnan(b->vmag))
+        return cmp(isnan(a->vmag), isnan(b->vmag));
+    return cmp(a->vmag, b->vmag);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int core_query_cone(int frame, const double center[3], double radius,
+                    double max_vmag, const char *filter,
+                    int offset, int nb, obj_t **out, int *code)
+{
+    int i, r, ret;
+    double dir[3], cap[4];
+    obj_t *module;
+    query_t query = {.max_vmag = max_vmag, .filter = filter};
+    observer_t *obs = core->observer;
+
+    if (!g_query.pix_caps_init) {
+        for (i = 0; i < GRID_NPIX; i++)
+            healpix_get_bounding_cap(GRID_NSIDE, i, g_query.pix_caps[i]);
+        g_query.pix_caps_init = true;
+    }
+    if (code) *code = 200;
+    observer_update(obs, true);
+    vec3_normalize(center, dir);
+    convert_frame(obs, frame, FRAME_ICRF, true, dir, query.cap);
+    query.cap[3] = cos(radius);
+
+    DL_FOREACH(core->obj.children, module) {
+        if (module->klass->list_cone) {
+            convert_frame(obs, FRAME_ICRF, FRAME_ASTROM, true, query.cap, cap);
+            cap[3] = cos(fmin(radius + LIST_CONE_MARGIN, M_PI));
+            r = module->klass->list_cone(module, cap, max_vmag, &query,
+                                         on_cone_obj);
+            if (r == MODULE_AGAIN && code) *code = 0;
+            continue;
+        }
+        if (!module->klass->list && !(module->klass->flags & OBJ_LISTABLE))
+            continue;
+        query_grid(&query, module);
+    }
+
+    qsort(query.results, query.nb, sizeof(*query.results), result_cmp);
+    for (i = 0; i < query.nb; i++) {
+        if (i >= offset && i < offset + nb)
+            out[i - offset] = query.results[i].obj;
+        else
+            obj_release(query.results[i].obj);
+    }
+    ret = query.nb;
+    free(query.results);
+    return ret;
+}
+
+void query_on_module_removed(const obj_t *module)
+{
+    grid_t *grid;
+    HASH_FIND_PTR(g_query.grids, &module, grid);
+    if (!grid) return;
+    HASH_DEL(g_query.grids, grid);
+    grid_clear(grid);
+    free(grid);
+}
+
+void query_release(void)
+{
+    grid_t *grid, *tmp;
+    HASH_ITER(hh, g_query.grids, grid, tmp) {
+        HASH_DEL(g_query.grids, grid);
+        grid_clear(grid);
+        free(grid);
+    }
+}
+
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_query_cone(void)
+{
+    obj_t *sun, *out[2];
+    double pvo[2][4];
+    int i, nb, code;
+
+    core_init(100, 100, 1.0);
+    sun = core_get_planet(PLANET_SUN);
+    obj_get_pvo(sun, core->observer, pvo);
+    nb = core_query_cone(FRAME_ICRF, pvo[0], 1.0 * DD2R, NAN, NULL,
+                         0, 2, out, &code);
+    assert(nb >= 1 && code == 200);
+    assert(out[0] == sun); // The brightest first.
+    for (i = 0; i < nb && i < 2; i++) obj_release(out[i]);
+    // Only the planets.
+    nb = core_query_cone(FRAME_ICRF, pvo[0], 1.0 * DD2R, NAN, "Pla",
+                         0, 2, out, &code);
+    for (i = 0; i < nb && i < 2; i++) {
+        assert(out[i] != sun);
+        obj_release(out[i]);
+    }
+    obj_release(sun);
+}
+
+TEST_REGISTER(NULL, test_query_cone, TEST_AUTO);
+
+#endif
@@ -0,0 +1,66 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "obj.h"
+
+/*
+ * File: query.h
+ * Spatial queries over all the modules objects.
+ */
+
+/*
+ * Function: core_query_cone
+ * List the objects inside a cone of the sky, sorted by magnitude.
+ *
+ * The modules that implement the list_cone method (stars, dsos) only look
+ * at the tiles intersecting the cone.  For the other listable modules
+ * (planets, comets, satellites...), we keep a healpix grid of the objects
+ * positions, that is only recomputed when the observer changes.
+ *
+ * Parameters:
+ *   frame    - Frame of the center direction.  One of the <FRAME> enum
+ *              values.
+ *   center   - Direction of the cone center.
+ *   radius   - Angular radius of the cone (rad).
+ *   max_vmag - Only return objects brighter than this, or NAN.
+ *   filter   - Only return objects matching this type (see otype_match),
+ *              or NULL.
+ *   offset   - Index of the first result to return, for paging.
+ *   nb       - Max number of results to return.
+ *   out      - Receive the objects, brightest first.  The caller should
+ *              release them with obj_release.
+ *   code     - Set to 200 if all the data was available, or to 0 if some
+ *              data is still loading, in which case we can query again
+ *              later to get more results.  Can be NULL.
+ *
+ * Return:
+ *   The total number of objects in the cone, that can be more than the
+ *   number of objects returned.
+ */
+int core_query_cone(int frame, const double center[3], double radius,
+                    double max_vmag, const char *filter,
+                    int offset, int nb, obj_t **out, int *code);
+
+/*
+ * Function: query_on_module_removed
+ * Release the objects kept by the queries for a module removed from the
+ * core.
+ */
+void query_on_module_removed(const obj_t *module);
+
+/*
+ * Function: query_release
+ * Release the objects kept by the queries, before the modules are deleted.
+ */
+void query_release(void);
+
+#endif // QUERY_H
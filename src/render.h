@@ -23,6 +23,30 @@ typedef struct uv_map uv_map_t;
 typedef struct texture texture_t;
 typedef struct projection projection_t;
 typedef struct obj obj_t;
+typedef struct arena arena_t;
+
+/*
+ * Type: render_stats_t
+ * Counters of what has been rendered during a frame.
+ *
+ * Both the OpenGL and the headless renderers fill them the same way, when
+ * the render functions are called, so that we can compare the amount of
+ * work done per frame without a GPU.  Only nb_draws depends on the
+ * renderer batching.
+ */
+typedef struct render_stats {
+    int nb_items;       // Number of render calls (before batching).
+    int nb_draws;       // Number of flushed items, after batching.  Always
+                        // zero with the headless renderer.
+    int nb_points;      // Number of 2d and 3d points.
+    int nb_quads;
+    int nb_lines;
+    int nb_meshes;
+    int nb_texts;
+    int nb_textures;    // Number of 2d textures.
+    int nb_vg;          // Number of 2d ellipses, rects and lines.
+    int nb_models;
+} render_stats_t;
 
 // TODO: document those functions.
 
@@ -35,6 +59,12 @@ void render_prepare(renderer_t *rend,
 
 void render_finish(renderer_t *rend);
 
+// Return the renderer per frame memory arena, reset in render_finish.
+arena_t *render_get_arena(renderer_t *rend);
+
+// Get the stats of the last finished frame.
+void render_get_stats(const renderer_t *rend, render_stats_t *stats);
+
 void render_points_2d(renderer_t *rend, const painter_t *painter,
                       int n, const point_t *points);
 
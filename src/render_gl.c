@@ -7,6 +7,8 @@
  * repository.
  */
 
+#ifndef RENDER_HEADLESS
+
 #include "render.h"
 #include "swe.h"
 
@@ -292,6 +294,12 @@ struct renderer {
     item_t  *items;
     cache_t *grid_cache;
 
+    // Per frame memory for the render items, reset after each flush.
+    arena_t arena;
+
+    render_stats_t stats;       // Current frame stats.
+    render_stats_t last_stats;  // Stats of the last flushed frame.
+
 };
 
 // Weak linking, so that we can put the implementation in a module.
@@ -381,6 +389,32 @@ void render_prepare(renderer_t *rend, const projection_t *proj,
     rend->depth_max = DBL_MIN;
 }
 
+arena_t *render_get_arena(renderer_t *rend)
+{
+    return &rend->arena;
+}
+
+void render_get_stats(const renderer_t *rend, render_stats_t *stats)
+{
+    *stats = rend->last_stats;
+}
+
+// Create a new render item, only valid until the next flush.
+static item_t *item_new(renderer_t *rend)
+{
+    return arena_calloc(&rend->arena, 1, sizeof(item_t));
+}
+
+// Allocate an item buffer data from the frame arena.
+static void item_buf_alloc(renderer_t *rend, gl_buf_t *buf,
+                           const gl_buf_info_t *info, int capacity)
+{
+    memset(buf, 0, sizeof(*buf));
+    buf->info = info;
+    buf->data = arena_alloc(&rend->arena, capacity * info->size);
+    buf->capacity = capacity;
+}
+
 /*
  * Function: get_item
  * Try to get a render item we can batch with.
@@ -426,6 +460,8 @@ void render_points_2d(renderer_t *rend, const painter_t *painter,
         LOG_E("Try to render more than %d points: %d", MAX_POINTS, n);
         n = MAX_POINTS;
     }
+    rend->stats.nb_items++;
+    rend->stats.nb_points += n;
 
     item = get_item(rend, ITEM_POINTS, n, 0, NULL);
     if (item && item->points.halo != painter->points_halo)
@@ -434,10 +470,10 @@ void render_points_2d(renderer_t *rend, const painter_t *painter,
         item = NULL;
 
     if (!item) {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_POINTS;
         item->flags = painter->flags;
-        gl_buf_alloc(&item->buf, &POINTS_BUF, MAX_POINTS);
+        item_buf_alloc(rend, &item->buf, &POINTS_BUF, MAX_POINTS);
         vec4_to_float(painter->color, item->color);
         item->points.halo = painter->points_halo;
         DL_APPEND(rend->items, item);
@@ -475,6 +511,8 @@ void render_points_3d(renderer_t *rend, const painter_t *painter,
         LOG_E("Try to render more than %d points: %d", MAX_POINTS, n);
         n = MAX_POINTS;
     }
+    rend->stats.nb_items++;
+    rend->stats.nb_points += n;
 
     item = get_item(rend, ITEM_POINTS_3D, n, 0, NULL);
     if (item && item->points.halo != painter->points_halo)
@@ -483,10 +521,10 @@ void render_points_3d(renderer_t *rend, const painter_t *painter,
         item = NULL;
 
     if (!item) {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_POINTS_3D;
         item->flags = painter->flags;
-        gl_buf_alloc(&item->buf, &POINTS_3D_BUF, MAX_POINTS);
+        item_buf_alloc(rend, &item->buf, &POINTS_3D_BUF, MAX_POINTS);
         vec4_to_float(painter->color, item->color);
         item->points.halo = painter->points_halo;
         DL_APPEND(rend->items, item);
@@ -533,8 +571,11 @@ static const double (*get_grid(renderer_t *rend,
 
     *should_delete = !can_cache;
     if (can_cache) {
-        if (!rend->grid_cache)
+        if (!rend->grid_cache) {
             rend->grid_cache = cache_create(GRID_CACHE_SIZE, 1);
+            // Cheap to recompute, so evicted first.
+            cache_set_info(rend->grid_cache, "grids", 0);
+        }
         grid = cache_get(rend->grid_cache, &key, sizeof(key));
         if (grid)
             return grid;
@@ -590,10 +631,10 @@ static void quad_planet(
     n = grid_size + 1;
 
     assert(painter->flags & PAINTER_ENABLE_DEPTH);
-    item = calloc(1, sizeof(*item));
+    item = item_new(rend);
     item->type = ITEM_PLANET;
-    gl_buf_alloc(&item->buf, &PLANET_BUF, n * n * 4);
-    gl_buf_alloc(&item->indices, &INDICES_BUF, n * n * 6);
+    item_buf_alloc(rend, &item->buf, &PLANET_BUF, n * n * 4);
+    item_buf_alloc(rend, &item->indices, &INDICES_BUF, n * n * 6);
     vec4_to_float(painter->color, item->color);
     item->flags = painter->flags;
     item->planet.shadow_color_tex = painter->planet.shadow_color_tex;
@@ -697,6 +738,8 @@ void render_quad(renderer_t *rend, const painter_t *painter,
     bool should_delete_grid;
     texture_t *tex = painter->textures[PAINTER_TEX_COLOR].tex;
 
+    rend->stats.nb_items++;
+    rend->stats.nb_quads++;
     // Special case for planet shader.
     if (painter->flags & (PAINTER_PLANET_SHADER | PAINTER_RING_SHADER))
         return quad_planet(rend, painter, frame, grid_size, map);
@@ -712,27 +755,27 @@ void render_quad(renderer_t *rend, const painter_t *painter,
                 memcmp(item->atm.sun, painter->atm.sun, sizeof(item->atm.sun))))
             item = NULL;
         if (!item) {
-            item = calloc(1, sizeof(*item));
+            item = item_new(rend);
             item->type = ITEM_ATMOSPHERE;
-            gl_buf_alloc(&item->buf, &ATMOSPHERE_BUF, 256);
-            gl_buf_alloc(&item->indices, &INDICES_BUF, 256 * 6);
+            item_buf_alloc(rend, &item->buf, &ATMOSPHERE_BUF, 256);
+            item_buf_alloc(rend, &item->indices, &INDICES_BUF, 256 * 6);
             memcpy(item->atm.p, painter->atm.p, sizeof(item->atm.p));
             memcpy(item->atm.sun, painter->atm.sun, sizeof(item->atm.sun));
         }
     } else if (painter->flags & PAINTER_FOG_SHADER) {
         item = get_item(rend, ITEM_FOG, n * n, grid_size * grid_size * 6, tex);
         if (!item) {
-            item = calloc(1, sizeof(*item));
+            item = item_new(rend);
             item->type = ITEM_FOG;
             vec4_copy(painter->color, item->color);
-            gl_buf_alloc(&item->buf, &FOG_BUF, 256);
-            gl_buf_alloc(&item->indices, &INDICES_BUF, 256 * 6);
+            item_buf_alloc(rend, &item->buf, &FOG_BUF, 256);
+            item_buf_alloc(rend, &item->indices, &INDICES_BUF, 256 * 6);
         }
     } else {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_TEXTURE;
-        gl_buf_alloc(&item->buf, &TEXTURE_BUF, n * n);
-        gl_buf_alloc(&item->indices, &INDICES_BUF, n * n * 6);
+        item_buf_alloc(rend, &item->buf, &TEXTURE_BUF, n * n);
+        item_buf_alloc(rend, &item->indices, &INDICES_BUF, n * n * 6);
     }
 
     ofs = item->buf.nb;
@@ -797,11 +840,11 @@ static void texture_2d(renderer_t *rend, texture_t *tex,
     if (item && memcmp(item->color, color, sizeof(color))) item = NULL;
 
     if (!item) {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_TEXTURE_2D;
         item->flags = flags;
-        gl_buf_alloc(&item->buf, &TEXTURE_2D_BUF, 64 * 4);
-        gl_buf_alloc(&item->indices, &INDICES_BUF, 64 * 6);
+        item_buf_alloc(rend, &item->buf, &TEXTURE_2D_BUF, 64 * 4);
+        item_buf_alloc(rend, &item->indices, &INDICES_BUF, 64 * 6);
         item->tex = tex;
         item->tex->ref++;
         memcpy(item->color, color, sizeof(color));
@@ -834,6 +877,8 @@ void render_texture(renderer_t *rend, texture_t  *tex,
 {
     int i;
     double verts[4][2], w, h;
+    rend->stats.nb_items++;
+    rend->stats.nb_textures++;
     w = size;
     h = size * tex->h / tex->w;
     for (i = 0; i < 4; i++) {
@@ -1063,7 +1108,7 @@ static void text_using_nanovg(renderer_t *rend,
     }
 
     if (!bounds) {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_TEXT;
         item->flags = painter->flags;
         vec4_to_float(color, item->color);
@@ -1132,6 +1177,10 @@ void render_text(renderer_t *rend, const painter_t *painter,
         return;
     }
 
+    if (!bounds) {
+        rend->stats.nb_items++;
+        rend->stats.nb_texts++;
+    }
     if (sys_callbacks.render_text) {
         text_using_texture(rend, painter, text, win_pos, view_pos, align,
                            effects, size, color, angle, bounds);
@@ -1735,6 +1784,7 @@ static void rend_flush(renderer_t *rend)
 #endif
 
     DL_FOREACH_SAFE(rend->items, item, tmp) {
+        rend->stats.nb_draws++;
         switch (item->type) {
         case ITEM_LINES:
             item_lines_render(rend, item);
@@ -1784,9 +1834,6 @@ static void rend_flush(renderer_t *rend)
             texture_release(item->planet.normalmap);
         if (item->type == ITEM_GLTF)
             json_builder_free(item->gltf.args);
-        gl_buf_release(&item->buf);
-        gl_buf_release(&item->indices);
-        free(item);
     }
     // Reset to default OpenGL settings.
     GL(glDepthMask(GL_TRUE));
@@ -1796,6 +1843,9 @@ static void rend_flush(renderer_t *rend)
 void render_finish(renderer_t *rend)
 {
     rend_flush(rend);
+    arena_reset(&rend->arena);
+    rend->last_stats = rend->stats;
+    memset(&rend->stats, 0, sizeof(rend->stats));
 }
 
 void render_line(renderer_t *rend, const painter_t *painter,
@@ -1810,6 +1860,8 @@ void render_line(renderer_t *rend, const painter_t *painter,
 
     if (size <= 1) return;
     assert(painter->lines.glow); // Only glowing lines supported for now.
+    rend->stats.nb_items++;
+    rend->stats.nb_lines++;
     vec4_to_float(painter->color, color);
     mesh = line_to_mesh(line, win, size, fmax(10, painter->lines.width + 2));
 
@@ -1836,11 +1888,11 @@ void render_line(renderer_t *rend, const painter_t *painter,
         item = NULL;
 
     if (!item) {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_LINES;
         item->flags = painter->flags;
-        gl_buf_alloc(&item->buf, &LINES_BUF, SIZE);
-        gl_buf_alloc(&item->indices, &INDICES_BUF, SIZE);
+        item_buf_alloc(rend, &item->buf, &LINES_BUF, SIZE);
+        item_buf_alloc(rend, &item->indices, &INDICES_BUF, SIZE);
         item->lines.width = painter->lines.width;
         item->lines.glow = painter->lines.glow;
         item->lines.dash_length = painter->lines.dash_length;
@@ -1892,6 +1944,8 @@ void render_mesh(renderer_t *rend, const painter_t *painter,
     color[2] = painter->color[2] * 255;
     color[3] = painter->color[3] * 255;
     if (!color[3]) return;
+    rend->stats.nb_items++;
+    rend->stats.nb_meshes++;
 
     item = get_item(rend, ITEM_MESH, verts_count, indices_count, NULL);
     if (item && (use_stencil != item->mesh.use_stencil)) item = NULL;
@@ -1899,13 +1953,14 @@ void render_mesh(renderer_t *rend, const painter_t *painter,
     if (item && item->mesh.stroke_width != painter->lines.width) item = NULL;
 
     if (!item) {
-        item = calloc(1, sizeof(*item));
+        item = item_new(rend);
         item->type = ITEM_MESH;
         item->mesh.mode = mode;
         item->mesh.stroke_width = painter->lines.width;
         item->mesh.use_stencil = use_stencil;
-        gl_buf_alloc(&item->buf, &MESH_BUF, fmax(verts_count, 1024));
-        gl_buf_alloc(&item->indices, &INDICES_BUF, fmax(indices_count, 1024));
+        item_buf_alloc(rend, &item->buf, &MESH_BUF, fmax(verts_count, 1024));
+        item_buf_alloc(rend, &item->indices, &INDICES_BUF,
+                       fmax(indices_count, 1024));
         DL_APPEND(rend->items, item);
     }
 
@@ -1933,7 +1988,9 @@ void render_ellipse_2d(renderer_t *rend, const painter_t *painter,
                        double angle, double dashes)
 {
     item_t *item;
-    item = calloc(1, sizeof(*item));
+    rend->stats.nb_items++;
+    rend->stats.nb_vg++;
+    item = item_new(rend);
     item->type = ITEM_VG_ELLIPSE;
     vec2_to_float(pos, item->vg.pos);
     vec2_to_float(size, item->vg.size);
@@ -1949,7 +2006,9 @@ void render_rect_2d(renderer_t *rend, const painter_t *painter,
                     double angle)
 {
     item_t *item;
-    item = calloc(1, sizeof(*item));
+    rend->stats.nb_items++;
+    rend->stats.nb_vg++;
+    item = item_new(rend);
     item->type = ITEM_VG_RECT;
     vec2_to_float(pos, item->vg.pos);
     vec2_to_float(size, item->vg.size);
@@ -1963,7 +2022,9 @@ void render_line_2d(renderer_t *rend, const painter_t *painter,
                     const double p1[2], const double p2[2])
 {
     item_t *item;
-    item = calloc(1, sizeof(*item));
+    rend->stats.nb_items++;
+    rend->stats.nb_vg++;
+    item = item_new(rend);
     item->type = ITEM_VG_LINE;
     vec2_to_float(p1, item->vg.pos);
     vec2_to_float(p2, item->vg.pos2);
@@ -2025,7 +2086,9 @@ void render_model_3d(renderer_t *rend, const painter_t *painter,
     item_t *item;
     double depth_range[2];
 
-    item = calloc(1, sizeof(*item));
+    rend->stats.nb_items++;
+    rend->stats.nb_models++;
+    item = item_new(rend);
     item->type = ITEM_GLTF;
     item->gltf.model = model;
     item->flags = painter->flags;
@@ -2153,3 +2216,5 @@ renderer_t* render_create(void)
 
     return rend;
 }
+
+#endif // RENDER_HEADLESS
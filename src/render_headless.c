@@ -0,0 +1,199 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+/*
+ * Headless renderer.
+ *
+ * Implementation of the render.h interface that doesn't need any OpenGL
+ * context.  Nothing is actually drawn: we only count the rendered items, so
+ * that we can run the full core_update / core_render pipeline on a machine
+ * without GPU, for example to benchmark the modules.
+ *
+ * Compiled instead of render_gl.c when RENDER_HEADLESS is defined.
+ */
+
+#ifdef RENDER_HEADLESS
+
+#include "render.h"
+#include "swe.h"
+
+struct renderer {
+    projection_t proj;
+    int     fb_size[2];
+    double  scale;
+
+    arena_t arena;
+    render_stats_t stats;       // Current frame stats.
+    render_stats_t last_stats;  // Stats of the last finished frame.
+};
+
+renderer_t* render_create(void)
+{
+    return calloc(1, sizeof(renderer_t));
+}
+
+void render_prepare(renderer_t *rend, const projection_t *proj,
+                    double win_w, double win_h, double scale,
+                    bool cull_flipped)
+{
+    rend->fb_size[0] = win_w * scale;
+    rend->fb_size[1] = win_h * scale;
+    rend->scale = scale;
+    rend->proj = *proj;
+}
+
+void render_finish(renderer_t *rend)
+{
+    arena_reset(&rend->arena);
+    rend->last_stats = rend->stats;
+    memset(&rend->stats, 0, sizeof(rend->stats));
+}
+
+arena_t *render_get_arena(renderer_t *rend)
+{
+    return &rend->arena;
+}
+
+void render_get_stats(const renderer_t *rend, render_stats_t *stats)
+{
+    *stats = rend->last_stats;
+}
+
+void render_points_2d(renderer_t *rend, const painter_t *painter,
+                      int n, const point_t *points)
+{
+    int i;
+    rend->stats.nb_items++;
+    rend->stats.nb_points += n;
+    // Still register the points, so that picking works as with the GL
+    // renderer.
+    for (i = 0; i < n; i++) {
+        if (!points[i].obj) continue;
+        areas_add_circle(core->areas, points[i].pos, points[i].size,
+                         points[i].obj);
+    }
+}
+
+void render_points_3d(renderer_t *rend, const painter_t *painter,
+                      int n, const point_3d_t *points)
+{
+    int i;
+    double win_xy[2];
+    rend->stats.nb_items++;
+    rend->stats.nb_points += n;
+    for (i = 0; i < n; i++) {
+        if (!points[i].obj) continue;
+        project_to_win_xy(painter->proj, points[i].pos, win_xy);
+        areas_add_circle(core->areas, win_xy, points[i].size, points[i].obj);
+    }
+}
+
+void render_quad(renderer_t *rend, const painter_t *painter,
+                 int frame, int grid_size, const uv_map_t *map)
+{
+    rend->stats.nb_items++;
+    rend->stats.nb_quads++;
+}
+
+void render_texture(renderer_t *rend, texture_t *tex,
+                    const double uv[4][2], const double pos[2], double size,
+                    const double color[4], double angle)
+{
+    rend->stats.nb_items++;
+    rend->stats.nb_textures++;
+}
+
+void render_text(renderer_t *rend, const painter_t *painter,
+                 const char *text, const double win_pos[2],
+                 const double view_pos[3],
+                 int align, int effects, double size,
+                 const double color[4], double angle,
+                 double bounds[4])
+{
+    double w, h;
+
+    if (!bounds) {
+        rend->stats.nb_items++;
+        rend->stats.nb_texts++;
+        return;
+    }
+
+    // We don't have any font, so use an approximation of the text size,
+    // good enough for the labels overlap tests.
+    w = u8_len(text) * size * 0.55;
+    h = size;
+    bounds[0] = win_pos[0];
+    bounds[1] = win_pos[1];
+    if (align & ALIGN_RIGHT)    bounds[0] -= w;
+    if (align & ALIGN_CENTER)   bounds[0] -= w / 2;
+    if (align & ALIGN_BOTTOM)   bounds[1] -= h;
+    if (align & ALIGN_MIDDLE)   bounds[1] -= h / 2;
+    if (align & ALIGN_BASELINE) bounds[1] -= h * 0.8;
+    bounds[2] = bounds[0] + w;
+    bounds[3] = bounds[1] + h;
+}
+
+void render_line(renderer_t *rend, const painter_t *painter,
+                 const double (*pos)[3], const double (*win)[3], int size)
+{
+    if (size <= 1) return;
+    rend->stats.nb_items++;
+    rend->stats.nb_lines++;
+}
+
+void render_mesh(renderer_t *rend, const painter_t *painter,
+                 int frame, int mode, int verts_count,
+                 const double verts[][3], int indices_count,
+                 const uint16_t indices[], bool use_stencil)
+{
+    if (painter->color[3] == 0.0) return;
+    rend->stats.nb_items++;
+    rend->stats.nb_meshes++;
+}
+
+void render_ellipse_2d(renderer_t *rend, const painter_t *painter,
+                       const double pos[2], const double size[2],
+                       double angle, double dashes)
+{
+    rend->stats.nb_items++;
+    rend->stats.nb_vg++;
+}
+
+void render_rect_2d(renderer_t *rend, const painter_t *painter,
+                    const double pos[2], const double size[2],
+                    double angle)
+{
+    rend->stats.nb_items++;
+    rend->stats.nb_vg++;
+}
+
+void render_line_2d(renderer_t *rend, const painter_t *painter,
+                    const double p1[2], const double p2[2])
+{
+    rend->stats.nb_items++;
+    rend->stats.nb_vg++;
+}
+
+void render_model_3d(renderer_t *rend, const painter_t *painter,
+                     const char *model, const double model_mat[4][4],
+                     const double view_mat[4][4], const double proj_mat[4][4],
+                     const double light_dir[3], const json_value *args)
+{
+    rend->stats.nb_items++;
+    rend->stats.nb_models++;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void core_add_font(renderer_t *rend, const char *name,
+                   const char *url, const uint8_t *data,
+                   int size)
+{
+}
+
+#endif // RENDER_HEADLESS
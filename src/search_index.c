@@ -0,0 +1,432 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "swe.h"
+
+#include <strings.h>
+
+/*
+ * All the entries are stored in a single array.  The first part of the
+ * array is sorted by designation, and the entries added since the last
+ * search are appended after it.  Before a search we sort the new entries
+ * and merge them into the sorted part, so that adding entries stays cheap
+ * while the modules load their data.
+ */
+
+// Max depth of aliases resolution, to prevent loops.
+#define MAX_ALIAS_DEPTH 4
+
+typedef struct {
+    char        *dsgn;
+    obj_t       *module;
+    obj_t       *obj;       // Object, if it stays in memory.
+    const char  *source;    // Else module source and hint.
+    uint64_t    hint;
+    char        *target;    // Else designation of the object.
+    float       vmag;
+} entry_t;
+
+// Modules and objects referenced by the entries and hints, so that
+// search_index_remove can return quickly for the others.
+typedef struct {
+    UT_hash_handle  hh;
+    const obj_t     *obj;
+    int             nb;         // Number of entries and hints using it.
+} ref_t;
+
+// Set of the module hints already added.
+typedef struct {
+    UT_hash_handle  hh;
+    struct {
+        const obj_t *module;
+        const char  *source;
+        uint64_t    hint;
+    } key;
+} hint_t;
+
+static struct {
+    entry_t     *entries;
+    int         nb;
+    int         nb_sorted;  // Number of sorted entries at the start.
+    int         allocated;
+    hint_t      *hints;
+    ref_t       *refs;
+} g_index = {};
+
+// Common designation prefixes tried for the completion.
+static const char *PREFIXES[] = {
+    "", "NAME ", "* ", "V* ", "MPC ", "Cl ", "Cl* ", "** ", "LATIN "};
+
+static void add_ref(const obj_t *obj)
+{
+    ref_t *ref;
+    HASH_FIND_PTR(g_index.refs, &obj, ref);
+    if (!ref) {
+        ref = calloc(1, sizeof(*ref));
+        ref->obj = obj;
+        HASH_ADD_PTR(g_index.refs, obj, ref);
+    }
+    ref->nb++;
+}
+
+static void remove_ref(const obj_t *obj)
+{
+    ref_t *ref;
+    HASH_FIND_PTR(g_index.refs, &obj, ref);
+    assert(ref);
+    if (--ref->nb > 0) return;
+    HASH_DEL(g_index.refs, ref);
+    free(ref);
+}
+
+static entry_t *add_entry(obj_t *module, const char *dsgn, double vmag)
+{
+    entry_t *entry;
+    if (g_index.nb >= g_index.allocated) {
+        g_index.allocated = g_index.allocated ? g_index.allocated * 2 : 1024;
+        g_index.entries = realloc(g_index.entries,
+                                  g_index.allocated * sizeof(*entry));
+    }
+    entry = &g_index.entries[g_index.nb++];
+    memset(entry, 0, sizeof(*entry));
+    entry->dsgn = strdup(dsgn);
+    entry->module = module;
+    entry->vmag = isnan(vmag) ? INFINITY : vmag;
+    add_ref(module);
+    return entry;
+}
+
+static void on_obj_designation(const obj_t *obj, void *user, const char *dsgn)
+{
+    obj_t *module = USER_GET(user, 0);
+    double vmag = *(double*)USER_GET(user, 1);
+    entry_t *entry = add_entry(module, dsgn, vmag);
+    entry->obj = (obj_t*)obj;
+    add_ref(obj);
+}
+
+void search_index_add_obj(obj_t *module, obj_t *obj, double vmag)
+{
+    obj_get_designations(obj, USER_PASS(module, &vmag), on_obj_designation);
+}
+
+static hint_t *find_hint(const obj_t *module, const char *source,
+                         uint64_t hint)
+{
+    hint_t tmp, *ret;
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.key.module = module;
+    tmp.key.source = source;
+    tmp.key.hint = hint;
+    HASH_FIND(hh, g_index.hints, &tmp.key, sizeof(tmp.key), ret);
+    return ret;
+}
+
+void search_index_add_hint(obj_t *module, const char *source, uint64_t hint,
+                           const char *dsgn, double vmag)
+{
+    entry_t *entry;
+    hint_t *h;
+
+    if (!find_hint(module, source, hint)) {
+        h = calloc(1, sizeof(*h));
+        h->key.module = module;
+        h->key.source = source;
+        h->key.hint = hint;
+        HASH_ADD(hh, g_index.hints, key, sizeof(h->key), h);
+        add_ref(module);
+    }
+    if (!dsgn) return;
+    entry = add_entry(module, dsgn, vmag);
+    entry->source = source;
+    entry->hint = hint;
+}
+
+bool search_index_has_hint(const obj_t *module, const char *source,
+                           uint64_t hint)
+{
+    return find_hint(module, source, hint) != NULL;
+}
+
+void search_index_add_alias(obj_t *module, const char *dsgn,
+                            const char *target)
+{
+    entry_t *entry = add_entry(module, dsgn, NAN);
+    entry->target = strdup(target);
+}
+
+void search_index_remove(const obj_t *obj)
+{
+    int i, n = 0, nb_sorted = 0;
+    entry_t *entry;
+    hint_t *h, *tmp;
+    ref_t *ref;
+
+    HASH_FIND_PTR(g_index.refs, &obj, ref);
+    if (!ref) return;
+
+    for (i = 0; i < g_index.nb; i++) {
+        entry = &g_index.entries[i];
+        if (entry->module == obj || entry->obj == obj) {
+            remove_ref(entry->module);
+            if (entry->obj) remove_ref(entry->obj);
+            free(entry->dsgn);
+            free(entry->target);
+            continue;
+        }
+        if (i < g_index.nb_sorted) nb_sorted++;
+        g_index.entries[n++] = *entry;
+    }
+    g_index.nb = n;
+    g_index.nb_sorted = nb_sorted;
+
+    HASH_ITER(hh, g_index.hints, h, tmp) {
+        if (h->key.module != obj) continue;
+        remove_ref(obj);
+        HASH_DEL(g_index.hints, h);
+        free(h);
+    }
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+    return strcasecmp(((const entry_t*)a)->dsgn, ((const entry_t*)b)->dsgn);
+}
+
+// Sort the new entries and merge them with the sorted ones.
+static void prepare(void)
+{
+    int i, j, k, n = g_index.nb_sorted;
+    entry_t *entries = g_index.entries, *merged;
+
+    if (g_index.nb == n) return;
+    qsort(entries + n, g_index.nb - n, sizeof(*entries), entry_cmp);
+    if (n > 0) {
+        merged = malloc(g_index.allocated * sizeof(*merged));
+        for (i = 0, j = n, k = 0; i < n || j < g_index.nb; k++) {
+            if (j == g_index.nb ||
+                    (i < n && entry_cmp(&entries[i], &entries[j]) <= 0))
+                merged[k] = entries[i++];
+            else
+                merged[k] = entries[j++];
+        }
+        free(g_index.entries);
+        g_index.entries = merged;
+    }
+    g_index.nb_sorted = g_index.nb;
+}
+
+// Index of the first entry whose designation is not lower than the key.
+// If len is not zero, only compare the first len characters.
+static int lower_bound(const char *key, int len)
+{
+    int lo = 0, hi = g_index.nb_sorted, mid, r;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        r = len ? strncasecmp(g_index.entries[mid].dsgn, key, len) :
+                  strcasecmp(g_index.entries[mid].dsgn, key);
+        if (r < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void on_list_designation(const obj_t *obj, void *user,
+                                const char *dsgn)
+{
+    const char *query = USER_GET(user, 0);
+    obj_t **ret = USER_GET(user, 1);
+    if (*ret) return;
+    if (strcasecmp(query, dsgn) == 0) *ret = obj_retain((obj_t*)obj);
+}
+
+static int on_list(void *user, obj_t *obj)
+{
+    obj_t **ret = USER_GET(user, 1);
+    obj_get_designations(obj, user, on_list_designation);
+    return *ret ? 1 : 0;
+}
+
+static obj_t *resolve(const entry_t *entry)
+{
+    static int depth = 0;
+    obj_t *ret = NULL;
+    int code;
+
+    if (entry->obj) return obj_retain(entry->obj);
+    if (entry->target) {
+        if (depth >= MAX_ALIAS_DEPTH) return NULL;
+        if (strncmp(entry->target, "HIP ", 4) == 0)
+            return obj_get_by_hip(atoi(entry->target + 4), &code);
+        depth++;
+        ret = core_search(entry->target);
+        depth--;
+        return ret;
+    }
+    module_list_objs(entry->module, NAN, entry->hint, entry->source,
+                     USER_PASS(entry->dsgn, &ret), on_list);
+    return ret;
+}
+
+obj_t *search_index_get(const char *dsgn)
+{
+    int i;
+    obj_t *ret;
+
+    prepare();
+    for (i = lower_bound(dsgn, 0); i < g_index.nb_sorted; i++) {
+        if (strcasecmp(g_index.entries[i].dsgn, dsgn) != 0) break;
+        ret = resolve(&g_index.entries[i]);
+        if (ret) return ret;
+    }
+    return NULL;
+}
+
+typedef struct {
+    const entry_t *entry;
+    bool exact;
+    int len;
+} candidate_t;
+
+static int candidate_cmp(const void *a_, const void *b_)
+{
+    const candidate_t *a = a_, *b = b_;
+    if (a->exact != b->exact) return a->exact ? -1 : +1;
+    if (a->entry->vmag != b->entry->vmag)
+        return cmp(a->entry->vmag, b->entry->vmag);
+    if (a->len != b->len) return a->len - b->len;
+    return strcasecmp(a->entry->dsgn, b->entry->dsgn);
+}
+
+// Add a candidate to a list of the best candidates, sorted by rank and
+// without duplicated designations.
+static void add_candidate(candidate_t *list, int *nb, int max,
+                          const candidate_t *c)
+{
+    int i;
+
+    if (*nb == max && candidate_cmp(c, &list[max - 1]) >= 0) return;
+    for (i = 0; i < *nb; i++) {
+        if (strcasecmp(list[i].entry->dsgn, c->entry->dsgn) != 0) continue;
+        if (candidate_cmp(c, &list[i]) >= 0) return;
+        memmove(&list[i], &list[i + 1], (*nb - i - 1) * sizeof(*list));
+        (*nb)--;
+        break;
+    }
+    for (i = *nb; i > 0 && candidate_cmp(c, &list[i - 1]) < 0; i--) {}
+    if (*nb == max) (*nb)--;
+    memmove(&list[i + 1], &list[i], (*nb - i) * sizeof(*list));
+    list[i] = *c;
+    (*nb)++;
+}
+
+int search_index_complete(const char *prefix, int max, void *user,
+                          void (*f)(void *user, const char *dsgn))
+{
+    int i, j, len, nb = 0;
+    char key[256];
+    candidate_t *candidates, c;
+
+    if (!*prefix || max <= 0) return 0;
+    prepare();
+    // Rank all the matching entries as we scan them, only keeping the best
+    // ones, so that a short prefix doesn't miss the brightest objects.
+    candidates = calloc(max, sizeof(*candidates));
+    for (i = 0; i < ARRAY_SIZE(PREFIXES); i++) {
+        len = snprintf(key, sizeof(key), "%s%s", PREFIXES[i], prefix);
+        if (len >= sizeof(key)) break;
+        for (j = lower_bound(key, len); j < g_index.nb_sorted; j++) {
+            c.entry = &g_index.entries[j];
+            if (strncasecmp(c.entry->dsgn, key, len) != 0) break;
+            c.exact = strcasecmp(c.entry->dsgn, key) == 0;
+            c.len = strlen(c.entry->dsgn);
+            add_candidate(candidates, &nb, max, &c);
+        }
+    }
+    for (i = 0; i < nb; i++) f(user, candidates[i].entry->dsgn);
+    free(candidates);
+    return nb;
+}
+
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void on_complete(void *user, const char *dsgn)
+{
+    UT_string *s = user;
+    utstring_printf(s, "%s;", dsgn);
+}
+
+static void test_get_designations(
+        const obj_t *obj, void *user,
+        int (*f)(const obj_t *obj, void *user, const char *cat,
+                 const char *str))
+{
+    f(obj, user, "NAME", "Polar Test");
+}
+
+static void test_search_index(void)
+{
+    obj_klass_t klass = {.get_designations = test_get_designations};
+    obj_t module = {}, obj = {.klass = &klass};
+    UT_string s;
+    char dsgn[32];
+    int i;
+
+    utstring_init(&s);
+    search_index_add_hint(&module, NULL, 10, "NAME Polaris", 2.0);
+    search_index_add_hint(&module, NULL, 10, "HIP 11767", 2.0);
+    search_index_add_hint(&module, NULL, 11, "NAME Pollux", 1.1);
+    search_index_add_alias(&module, "Pole Star", "NAME Polaris");
+    search_index_add_alias(&module, "pollux", "NAME Pollux");
+    search_index_add_hint(&module, NULL, 12, "NAME Pol", 5.0);
+    assert(search_index_has_hint(&module, NULL, 11));
+    assert(!search_index_has_hint(&module, NULL, 13));
+
+    search_index_complete("pol", 10, &s, on_complete);
+    assert(strcmp(utstring_body(&s),
+           "NAME Pol;NAME Pollux;NAME Polaris;pollux;Pole Star;") == 0);
+    utstring_clear(&s);
+    search_index_complete("POLL", 1, &s, on_complete);
+    assert(strcmp(utstring_body(&s), "NAME Pollux;") == 0);
+
+    // The entries pointing to a removed object are removed too.
+    search_index_add_obj(&module, &obj, 0.5);
+    utstring_clear(&s);
+    search_index_complete("polar", 10, &s, on_complete);
+    assert(strcmp(utstring_body(&s),
+           "NAME Polar Test;NAME Polaris;") == 0);
+    search_index_remove(&obj);
+    utstring_clear(&s);
+    search_index_complete("polar", 10, &s, on_complete);
+    assert(strcmp(utstring_body(&s), "NAME Polaris;") == 0);
+
+    // The brightest match is found even after many others.
+    for (i = 0; i < 1000; i++) {
+        snprintf(dsgn, sizeof(dsgn), "NAME Pola %d", i);
+        search_index_add_hint(&module, NULL, 100 + i, dsgn, 10.0);
+    }
+    search_index_add_hint(&module, NULL, 99, "NAME Polz", -1.0);
+    utstring_clear(&s);
+    search_index_complete("pol", 2, &s, on_complete);
+    assert(strcmp(utstring_body(&s), "NAME Pol;NAME Polz;") == 0);
+
+    search_index_remove(&module);
+    assert(!search_index_has_hint(&module, NULL, 11));
+    utstring_clear(&s);
+    search_index_complete("pol", 10, &s, on_complete);
+    assert(utstring_len(&s) == 0);
+    utstring_done(&s);
+}
+
+TEST_REGISTER(NULL, test_search_index, TEST_AUTO);
+
+#endif
@@ -0,0 +1,125 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "obj.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * File: search_index.h
+ * Global index of the objects designations.
+ *
+ * The modules add the designations of their objects to the index as they
+ * load their data.  We can then find an object from one of its
+ * designations without iterating all the objects, and list the
+ * designations starting with a given prefix for the search auto
+ * completion.
+ *
+ * An entry can point to its object in three ways:
+ * - Directly, for the objects that stay in memory (planets, comets...).
+ * - With a module hint (see <module_list_objs>), for the objects that only
+ *   exist while their hips tile is loaded (stars, dsos).
+ * - With an other designation, for the sky cultures names.
+ *
+ * The comparisons are case insensitive.
+ */
+
+/*
+ * Function: search_index_add_obj
+ * Add all the designations of an object that stays in memory.
+ *
+ * The object is not retained: its entries are removed by <module_remove>,
+ * or the module has to call <search_index_remove> before deleting it.
+ *
+ * Parameters:
+ *   module - The module owning the object.
+ *   obj    - The object.
+ *   vmag   - Magnitude used to rank the completions, or NAN.
+ */
+void search_index_add_obj(obj_t *module, obj_t *obj, double vmag);
+
+/*
+ * Function: search_index_add_hint
+ * Add a designation of an object that can be listed with a module hint.
+ *
+ * Parameters:
+ *   module - The module owning the object.
+ *   source - Source passed to module_list_objs.  Not copied.  Can be NULL.
+ *   hint   - Hint passed to module_list_objs.
+ *   dsgn   - The designation, or NULL to only mark the hint as added
+ *            (see <search_index_has_hint>).
+ *   vmag   - Magnitude used to rank the completions, or NAN.
+ */
+void search_index_add_hint(obj_t *module, const char *source, uint64_t hint,
+                           const char *dsgn, double vmag);
+
+/*
+ * Function: search_index_has_hint
+ * Check if some designations have already been added for a module hint.
+ *
+ * This allows the modules to add the designations of a tile only the
+ * first time it is loaded.
+ */
+bool search_index_has_hint(const obj_t *module, const char *source,
+                           uint64_t hint);
+
+/*
+ * Function: search_index_add_alias
+ * Add a designation that refers to an object by an other designation.
+ *
+ * Parameters:
+ *   module - The module adding the alias.
+ *   dsgn   - The new designation.
+ *   target - Designation of the object, resolved with <core_search>.
+ */
+void search_index_add_alias(obj_t *module, const char *dsgn,
+                            const char *target);
+
+/*
+ * Function: search_index_remove
+ * Remove all the entries added by a module, or pointing to an object.
+ */
+void search_index_remove(const obj_t *obj);
+
+/*
+ * Function: search_index_get
+ * Find an object from one of its designations.
+ *
+ * Return:
+ *   The object, or NULL if no object is found.  The caller should release
+ *   the returned object.
+ */
+obj_t *search_index_get(const char *dsgn);
+
+/*
+ * Function: search_index_complete
+ * List the designations that start with a given prefix.
+ *
+ * The prefix is also tried with the common designation prefixes ('NAME ',
+ * '* ', 'MPC '...), so that for example 'pola' matches 'NAME Polaris'.
+ * The results are ranked: exact matches first, then brightest first, then
+ * shortest first.  Duplicated designations are only returned once.
+ *
+ * Parameters:
+ *   prefix - The prefix to search for.
+ *   max    - Max number of results.
+ *   user   - Data passed to the callback.
+ *   f      - Callback called for each result, in rank order.
+ *
+ * Return:
+ *   The number of results.
+ */
+int search_index_complete(const char *prefix, int max, void *user,
+                          void (*f)(void *user, const char *dsgn));
+
+#endif // SEARCH_INDEX_H
@@ -0,0 +1,208 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "stars_index.h"
+#include "swe.h"
+
+/* The stars index format is as follow:
+ *
+ * Header (16 bytes):
+ *   4 bytes: magic string "STID"
+ *   4 bytes: format version (INDEX_VERSION)
+ *   4 bytes: number of HIP entries
+ *   4 bytes: number of Gaia entries
+ *
+ * HIP entries, sorted by HIP number (12 bytes per entry):
+ *   4 bytes: HIP number
+ *   4 bytes: nuniq of the tile
+ *   4 bytes: row of the star in the tile
+ *
+ * Gaia entries, sorted by source id (16 bytes per entry):
+ *   8 bytes: Gaia source id
+ *   4 bytes: nuniq of the tile
+ *   4 bytes: row of the star in the tile
+ *
+ * All the values are little endian.  The rows are the index of the stars
+ * once the tile rows have been sorted by magnitude (see stars.c), they are
+ * only a hint and should be checked against the tile data.
+ */
+
+#define INDEX_VERSION 1
+#define HEADER_SIZE 16
+#define HIP_ENTRY_SIZE 12
+#define GAIA_ENTRY_SIZE 16
+
+struct stars_index {
+    int             nb[2];      // Number of entries per type.
+    const uint8_t   *entries[2];
+};
+
+typedef struct {
+    uint64_t id;
+    int      i; // Index in the query.
+} query_t;
+
+static const int ENTRY_SIZES[2] = {HIP_ENTRY_SIZE, GAIA_ENTRY_SIZE};
+
+stars_index_t *stars_index_open(const void *data_, int size)
+{
+    const uint8_t *data = data_;
+    uint32_t version;
+    int nb_hip, nb_gaia;
+    stars_index_t *index;
+
+    if (size < HEADER_SIZE || memcmp(data, "STID", 4) != 0) {
+        LOG_E("Not a stars index");
+        return NULL;
+    }
+    memcpy(&version, data + 4, 4);
+    if (version != INDEX_VERSION) {
+        LOG_E("Unsupported stars index version: %d", version);
+        return NULL;
+    }
+    memcpy(&nb_hip, data + 8, 4);
+    memcpy(&nb_gaia, data + 12, 4);
+    if (nb_hip < 0 || nb_gaia < 0 ||
+        HEADER_SIZE + (int64_t)nb_hip * HIP_ENTRY_SIZE +
+                      (int64_t)nb_gaia * GAIA_ENTRY_SIZE > size)
+    {
+        LOG_E("Corrupted stars index");
+        return NULL;
+    }
+    index = calloc(1, sizeof(*index));
+    index->nb[STARS_INDEX_HIP] = nb_hip;
+    index->nb[STARS_INDEX_GAIA] = nb_gaia;
+    index->entries[STARS_INDEX_HIP] = data + HEADER_SIZE;
+    index->entries[STARS_INDEX_GAIA] =
+        data + HEADER_SIZE + nb_hip * HIP_ENTRY_SIZE;
+    return index;
+}
+
+void stars_index_close(stars_index_t *index)
+{
+    free(index);
+}
+
+static uint64_t entry_get_id(const stars_index_t *index, int type, int i)
+{
+    uint32_t v32;
+    uint64_t v64;
+    const uint8_t *entry = index->entries[type] + i * ENTRY_SIZES[type];
+    if (type == STARS_INDEX_HIP) {
+        memcpy(&v32, entry, 4);
+        return v32;
+    }
+    memcpy(&v64, entry, 8);
+    return v64;
+}
+
+static int query_cmp(const void *a, const void *b)
+{
+    return cmp(((const query_t*)a)->id, ((const query_t*)b)->id);
+}
+
+int stars_index_lookup(const stars_index_t *index, int type,
+                       int nb, const uint64_t *ids, stars_index_pos_t *out)
+{
+    int i, lo = 0, hi, mid, n, ret = 0;
+    uint32_t nuniq, row;
+    uint64_t nside;
+    const uint8_t *entry;
+    query_t *queries;
+
+    assert(type == STARS_INDEX_HIP || type == STARS_INDEX_GAIA);
+    n = index->nb[type];
+    queries = malloc(nb * sizeof(*queries));
+    for (i = 0; i < nb; i++) {
+        queries[i] = (query_t) {ids[i], i};
+        out[i] = (stars_index_pos_t) {-1, -1, -1};
+    }
+    qsort(queries, nb, sizeof(*queries), query_cmp);
+
+    // Since the queries are sorted, each search can start where the
+    // previous one ended.
+    for (i = 0; i < nb; i++) {
+        hi = n;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (entry_get_id(index, type, mid) < queries[i].id) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == n) break;
+        if (entry_get_id(index, type, lo) != queries[i].id) continue;
+        entry = index->entries[type] + lo * ENTRY_SIZES[type] +
+                (type == STARS_INDEX_HIP ? 4 : 8);
+        memcpy(&nuniq, entry, 4);
+        memcpy(&row, entry + 4, 4);
+        if (nuniq < 4) {
+            LOG_W_ONCE("Corrupted stars index entry");
+            continue;
+        }
+        out[queries[i].i].order = log2(nuniq / 4) / 2;
+        nside = 1 << out[queries[i].i].order;
+        out[queries[i].i].pix = nuniq - 4 * nside * nside;
+        out[queries[i].i].row = row;
+        ret++;
+    }
+    free(queries);
+    return ret;
+}
+
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+static void test_stars_index(void)
+{
+    uint8_t data[HEADER_SIZE + 3 * HIP_ENTRY_SIZE + 2 * GAIA_ENTRY_SIZE];
+    uint8_t *p = data;
+    stars_index_t *index;
+    stars_index_pos_t pos[4];
+    int i;
+    const uint32_t hips[3][3] = {{10, 4 + 1, 0}, {20, 16 + 5, 3},
+                                 {30, 16 + 7, 1}};
+    const uint64_t gaias[2] = {1000, 2000};
+    const uint64_t ids[4] = {30, 15, 10, 30};
+    uint32_t v;
+
+    memcpy(p, "STID", 4);
+    v = INDEX_VERSION; memcpy(p + 4, &v, 4);
+    v = 3; memcpy(p + 8, &v, 4);
+    v = 2; memcpy(p + 12, &v, 4);
+    p += HEADER_SIZE;
+    for (i = 0; i < 3; i++, p += HIP_ENTRY_SIZE)
+        memcpy(p, hips[i], HIP_ENTRY_SIZE);
+    for (i = 0; i < 2; i++, p += GAIA_ENTRY_SIZE) {
+        memcpy(p, &gaias[i], 8);
+        v = 4 + i; memcpy(p + 8, &v, 4);
+        v = i; memcpy(p + 12, &v, 4);
+    }
+
+    assert(!stars_index_open(data, sizeof(data) - 1));
+    index = stars_index_open(data, sizeof(data));
+    assert(index);
+    assert(stars_index_lookup(index, STARS_INDEX_HIP, 4, ids, pos) == 3);
+    assert(pos[0].order == 1 && pos[0].pix == 7 && pos[0].row == 1);
+    assert(pos[1].order == -1);
+    assert(pos[2].order == 0 && pos[2].pix == 1 && pos[2].row == 0);
+    assert(pos[3].order == 1 && pos[3].pix == 7);
+    assert(stars_index_lookup(index, STARS_INDEX_GAIA, 1, &gaias[1], pos)
+           == 1);
+    assert(pos[0].order == 0 && pos[0].pix == 1 && pos[0].row == 1);
+    // Corrupted tile nuniq.
+    v = 2; memcpy(data + HEADER_SIZE + 4, &v, 4);
+    assert(stars_index_lookup(index, STARS_INDEX_HIP, 1, &ids[2], pos) == 0);
+    assert(pos[0].order == -1);
+    stars_index_close(index);
+}
+
+TEST_REGISTER(NULL, test_stars_index, TEST_AUTO);
+
+#endif
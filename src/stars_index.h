@@ -0,0 +1,89 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef STARS_INDEX_H
+#define STARS_INDEX_H
+
+#include <stdint.h>
+
+/*
+ * File: stars_index.h
+ * Index of the stars surveys identifiers.
+ *
+ * A stars index maps the HIP and Gaia source ids of a stars survey to the
+ * position of the stars in the survey tiles, so that we can find a star
+ * without having to parse all the tiles that might contain it.  It can be
+ * created with tools/make-stars-index.py.  See stars_index.c for the
+ * format.
+ *
+ * The index data is used directly, without copy, so it can be a memory
+ * mapped file.
+ */
+
+typedef struct stars_index stars_index_t;
+
+// Type of identifiers in the index.
+enum {
+    STARS_INDEX_HIP,
+    STARS_INDEX_GAIA,
+};
+
+/*
+ * Type: stars_index_pos_t
+ * Position of a star in a survey.
+ *
+ * Attributes:
+ *   order - Healpix order of the tile, or -1 if the star is not found.
+ *   pix   - Healpix pix of the tile.
+ *   row   - Index of the star in the tile, once sorted by magnitude.
+ */
+typedef struct {
+    int order;
+    int pix;
+    int row;
+} stars_index_pos_t;
+
+/*
+ * Function: stars_index_open
+ * Create an index from its data.
+ *
+ * The data is not copied, and should stay valid until the index is closed.
+ *
+ * Return NULL in case of error.
+ */
+stars_index_t *stars_index_open(const void *data, int size);
+
+/*
+ * Function: stars_index_close
+ * Release an index returned by stars_index_open.
+ */
+void stars_index_close(stars_index_t *index);
+
+/*
+ * Function: stars_index_lookup
+ * Find the position of a list of stars.
+ *
+ * The ids are looked up in increasing order, so that we only go forward in
+ * the index data: looking up many ids at once only touches each page of
+ * the index once.
+ *
+ * Parameters:
+ *   index  - A stars index.
+ *   type   - STARS_INDEX_HIP or STARS_INDEX_GAIA.
+ *   nb     - Number of ids.
+ *   ids    - The ids to look for.
+ *   out    - Receive the position of each id.
+ *
+ * Return:
+ *   The number of ids found.
+ */
+int stars_index_lookup(const stars_index_t *index, int type,
+                       int nb, const uint64_t *ids, stars_index_pos_t *out);
+
+#endif // STARS_INDEX_H
@@ -33,6 +33,7 @@
 #include "log.h"
 #include "tests.h"
 
+#include "utils/arena.h"
 #include "utils/cache.h"
 #include "utils/fader.h"
 #include "utils/gesture.h"
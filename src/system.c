@@ -306,7 +306,7 @@ const char *sys_translate(const char *domain, const char *str)
 
 const char *translate_jp(const char *str) {
     int i;
-    for (i = 0; i<sizeof(translation); i++) {
+    for (i = 0; i < ARRAY_SIZE(translation); i++) {
       if (strcmp(str, translation[i][0]) == 0) {
         return translation[i][1];
       }
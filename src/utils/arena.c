@@ -0,0 +1,92 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Minimum size of the blocks we allocate.
+#define BLOCK_SIZE (1 << 20)
+
+#define ALIGN alignof(max_align_t)
+
+struct arena_block {
+    arena_block_t   *next;
+    size_t          size;   // Size of the data.
+    size_t          used;
+    alignas(ALIGN) unsigned char data[];
+};
+
+static arena_block_t *block_create(size_t size)
+{
+    arena_block_t *block;
+    block = malloc(sizeof(*block) + size);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    arena_block_t *block = arena->blocks;
+    void *ret;
+
+    size = (size + ALIGN - 1) & ~(ALIGN - 1);
+    if (!block || block->used + size > block->size) {
+        block = block_create(size > BLOCK_SIZE ? size : BLOCK_SIZE);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    ret = block->data + block->used;
+    block->used += size;
+    arena->nb_allocs++;
+    arena->size += size;
+    return ret;
+}
+
+void *arena_calloc(arena_t *arena, size_t nmemb, size_t size)
+{
+    void *ret = arena_alloc(arena, nmemb * size);
+    memset(ret, 0, nmemb * size);
+    return ret;
+}
+
+void arena_reset(arena_t *arena)
+{
+    arena_block_t *block, *next;
+    size_t size = 0;
+
+    // If we needed several blocks, replace them with a single one large
+    // enough for all, so that the next frame fits in a single block.
+    if (arena->blocks && arena->blocks->next) {
+        for (block = arena->blocks; block; block = next) {
+            next = block->next;
+            size += block->size;
+            free(block);
+        }
+        arena->blocks = block_create(size);
+    }
+    if (arena->blocks) arena->blocks->used = 0;
+    arena->nb_allocs = 0;
+    arena->size = 0;
+}
+
+void arena_release(arena_t *arena)
+{
+    arena_block_t *block, *next;
+    for (block = arena->blocks; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    memset(arena, 0, sizeof(*arena));
+}
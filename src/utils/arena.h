@@ -0,0 +1,67 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * File: arena.h
+ * Simple bump allocator for short lived memory.
+ *
+ * All the memory allocated from an arena is freed at once with
+ * <arena_reset>.  This is used for the data that only lives for the
+ * duration of a frame, so that we don't have to call malloc and free
+ * for each rendered tile or render item.
+ */
+
+typedef struct arena_block arena_block_t;
+
+/*
+ * Type: arena_t
+ * An arena allocator.  Can be zero initialized.
+ */
+typedef struct arena {
+    arena_block_t *blocks;  // Current block first.
+    int         nb_allocs;  // Number of allocations since the last reset.
+    size_t      size;       // Bytes allocated since the last reset.
+} arena_t;
+
+/*
+ * Function: arena_alloc
+ * Allocate memory from an arena.
+ *
+ * The returned memory is aligned for any type, and stays valid until the
+ * next call to <arena_reset> or <arena_release>.  It must not be freed.
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/*
+ * Function: arena_calloc
+ * Same as <arena_alloc>, but set the memory to zero.
+ */
+void *arena_calloc(arena_t *arena, size_t nmemb, size_t size);
+
+/*
+ * Function: arena_reset
+ * Free all the memory allocated from the arena.
+ *
+ * The memory blocks are kept for later allocations, so after a few
+ * frames an arena doesn't need to call malloc anymore.
+ */
+void arena_reset(arena_t *arena);
+
+/*
+ * Function: arena_release
+ * Free all the memory used by an arena, including the cached blocks.
+ */
+void arena_release(arena_t *arena);
+
+#endif // ARENA_H
@@ -9,27 +9,60 @@
 
 #include "cache.h"
 #include "uthash.h"
+#include "utlist.h"
 #include <assert.h>
+#include <stdint.h>
 #include <sys/time.h>
 
+/*
+ * The items are stored both in a hash table (for the lookup) and in a
+ * doubly linked list sorted by last usage time (for the eviction).  Every
+ * access moves the item at the end of the list, so the least recently used
+ * items are always at the front and cleanup never has to look at items
+ * that are still in their grace period.
+ *
+ * All the caches are also in a global list sorted by priority, so that
+ * when the global memory budget is exceeded we can evict the items of the
+ * lowest priority caches first.
+ */
+
+// Max number of memory usages tracked with cache_track_memory.
+#define MAX_TRACKED 8
+
 typedef struct item item_t;
 struct item {
     UT_hash_handle  hh;
-    char            key[256];
+    item_t          *next, *prev; // LRU list, oldest first.
     void            *data;
     int             cost;
     int             (*delfunc)(void *data);
-    // Used to give a grace period before we remove an item from the cache.
-    double          grace_time;
+    // Last time the item was used.  The item cannot be removed before
+    // the cache grace period has passed since then.
+    double          last_used;
+    char            key[]; // Allocated with the item.
 };
 
 struct cache {
-    item_t *items;
+    cache_t *next, *prev; // Global list, lowest priority first.
+    item_t *items; // Hash table.
+    item_t *lru;   // LRU list.
     int size;
     int max_size;
     double grace_period;
+    const char *name;
+    int priority;
 };
 
+// Global memory accounting.
+static struct {
+    cache_t *caches;
+    int64_t budget; // Zero for no budget.
+    struct {
+        const char *name;
+        int64_t size;
+    } tracked[MAX_TRACKED];
+} g_mem = {};
+
 static double get_unix_time(void)
 {
     struct timeval tv;
@@ -42,45 +75,105 @@ cache_t *cache_create(int size, double grace_period_sec)
     cache_t *cache = calloc(1, sizeof(*cache));
     cache->max_size = size;
     cache->grace_period = grace_period_sec;
+    cache->name = "cache";
+    DL_PREPEND(g_mem.caches, cache);
     return cache;
 }
 
-static void cleanup(cache_t *cache)
+static int priority_cmp(const cache_t *a, const cache_t *b)
 {
-    item_t *item, *tmp;
+    return a->priority - b->priority;
+}
+
+void cache_set_info(cache_t *cache, const char *name, int priority)
+{
+    cache->name = name;
+    cache->priority = priority;
+    DL_DELETE(g_mem.caches, cache);
+    DL_INSERT_INORDER(g_mem.caches, cache, priority_cmp);
+}
+
+// Move an item at the end of the LRU list.
+static void touch(cache_t *cache, item_t *item, double time)
+{
+    item->last_used = time;
+    if (item == cache->lru->prev) return; // Already last.
+    DL_DELETE(cache->lru, item);
+    DL_APPEND(cache->lru, item);
+}
+
+// Remove the least recently used items until the cache size is lower or
+// equal to a given value.
+static void evict(cache_t *cache, int64_t target)
+{
+    item_t *item;
+    int nb_kept = 0, nb = HASH_COUNT(cache->items);
     double time = get_unix_time();
-    HASH_ITER(hh, cache->items, item, tmp) {
-        if (!item->grace_time) {
-            item->grace_time = time;
-            continue;
-        }
-        if (time - item->grace_time < cache->grace_period) continue;
 
+    while ((item = cache->lru) && cache->size > target) {
+        // All the items after this one have been used more recently.
+        if (time - item->last_used < cache->grace_period) return;
         if (item->delfunc && item->delfunc(item->data) == CACHE_KEEP) {
-            item->grace_time = 0;
+            // Give it a new grace period.  Stop if all the items refused
+            // to be deleted, to prevent looping forever.
+            touch(cache, item, time);
+            if (++nb_kept >= nb) return;
             continue;
         }
         HASH_DEL(cache->items, item);
-        assert(item != cache->items);
+        DL_DELETE(cache->lru, item);
         cache->size -= item->cost;
         free(item);
-        if (cache->size < cache->max_size) return;
+        nb--;
+    }
+}
+
+static int64_t get_total_usage(void)
+{
+    int i;
+    int64_t ret = 0;
+    cache_t *cache;
+    DL_FOREACH(g_mem.caches, cache) ret += cache->size;
+    for (i = 0; i < MAX_TRACKED; i++) ret += g_mem.tracked[i].size;
+    return ret;
+}
+
+// Evict items from the lowest priority caches first, until we get under
+// the global memory budget.
+static void enforce_budget(void)
+{
+    cache_t *cache;
+    int64_t over, size;
+
+    if (!g_mem.budget) return;
+    over = get_total_usage() - g_mem.budget;
+    for (cache = g_mem.caches; cache && over > 0; cache = cache->next) {
+        size = cache->size;
+        evict(cache, size - over);
+        over -= size - cache->size;
     }
 }
 
+static void cleanup(cache_t *cache)
+{
+    evict(cache, cache->max_size - 1);
+    enforce_budget();
+}
+
 void cache_add(cache_t *cache, const void *key, int len, void *data,
                int cost, int (*delfunc)(void *data))
 {
     item_t *item;
-    assert(len <= sizeof(item->key));
     cache->size += cost;
-    if (cache->size >= cache->max_size) cleanup(cache);
-    item = calloc(1, sizeof(*item));
+    cleanup(cache);
+    item = calloc(1, sizeof(*item) + len);
     memcpy(item->key, key, len);
     item->data = data;
     item->cost = cost;
     item->delfunc = delfunc;
+    item->last_used = get_unix_time();
     HASH_ADD(hh, cache->items, key, len, item);
+    DL_APPEND(cache->lru, item);
 }
 
 void *cache_get(cache_t *cache, const void *key, int keylen)
@@ -88,10 +181,7 @@ void *cache_get(cache_t *cache, const void *key, int keylen)
     item_t *item;
     HASH_FIND(hh, cache->items, key, keylen, item);
     if (!item) return NULL;
-    item->grace_time = 0;
-    // Reinsert item on top of the hash list so that it stays sorted.
-    HASH_DEL(cache->items, item);
-    HASH_ADD(hh, cache->items, key, keylen, item);
+    touch(cache, item, get_unix_time());
     return item->data;
 }
 
@@ -103,7 +193,7 @@ void cache_set_cost(cache_t *cache, const void *key, int keylen, int cost)
     cache->size -= item->cost;
     item->cost = cost;
     cache->size += cost;
-    if (cache->size >= cache->max_size) cleanup(cache);
+    cleanup(cache);
 }
 
 /*
@@ -114,3 +204,123 @@ int cache_get_current_size(const cache_t *cache)
 {
     return cache->size;
 }
+
+void cache_delete(cache_t *cache)
+{
+    item_t *item, *tmp;
+    if (!cache) return;
+    HASH_ITER(hh, cache->items, item, tmp) {
+        HASH_DEL(cache->items, item);
+        if (item->delfunc) item->delfunc(item->data);
+        free(item);
+    }
+    DL_DELETE(g_mem.caches, cache);
+    free(cache);
+}
+
+void cache_set_budget(int64_t size)
+{
+    g_mem.budget = size;
+    enforce_budget();
+}
+
+void cache_track_memory(const char *name, int64_t delta)
+{
+    int i;
+    if (!delta) return;
+    for (i = 0; i < MAX_TRACKED; i++) {
+        if (!g_mem.tracked[i].name) g_mem.tracked[i].name = name;
+        if (strcmp(g_mem.tracked[i].name, name) == 0) break;
+    }
+    assert(i < MAX_TRACKED);
+    if (i == MAX_TRACKED) return;
+    g_mem.tracked[i].size += delta;
+    if (delta > 0) enforce_budget();
+}
+
+int64_t cache_get_memory_usage(
+        void *user, void (*f)(void *user, const char *name, int64_t size))
+{
+    int i;
+    cache_t *cache;
+    if (f) {
+        DL_FOREACH(g_mem.caches, cache) f(user, cache->name, cache->size);
+        for (i = 0; i < MAX_TRACKED && g_mem.tracked[i].name; i++)
+            f(user, g_mem.tracked[i].name, g_mem.tracked[i].size);
+    }
+    return get_total_usage();
+}
+
+
+/******** TESTS ***********************************************************/
+
+#if COMPILE_TESTS
+
+#include "tests.h"
+
+static int test_del(void *data)
+{
+    return 0;
+}
+
+// Not run automatically, use tests_run("cache") to get the numbers.
+static void bench_cache_n(int n)
+{
+    int i;
+    double t0, t1, t2;
+    cache_t *cache;
+
+    // Max size of half the items, so that the second half of the inserts
+    // all trigger an eviction.
+    cache = cache_create(n / 2, 0);
+    t0 = get_unix_time();
+    for (i = 0; i < n / 2; i++)
+        cache_add(cache, &i, sizeof(i), NULL, 1, test_del);
+    t1 = get_unix_time();
+    for (; i < n; i++)
+        cache_add(cache, &i, sizeof(i), NULL, 1, test_del);
+    t2 = get_unix_time();
+    assert(cache->size < n / 2);
+    LOG_I("cache %d items: insert %.1f ns/item, insert+evict %.1f ns/item",
+          n, (t1 - t0) * 1e9 / (n / 2), (t2 - t1) * 1e9 / (n - n / 2));
+
+    // Evict everything.
+    cache->max_size = 0;
+    cleanup(cache);
+    assert(!cache->items && !cache->lru);
+    cache_delete(cache);
+}
+
+static void test_budget(void)
+{
+    int i, data;
+    cache_t *low, *high;
+
+    low = cache_create(1000, 0);
+    high = cache_create(1000, 0);
+    cache_set_info(low, "test_low", -200);
+    cache_set_info(high, "test_high", -100);
+    for (i = 0; i < 10; i++) {
+        cache_add(low, &i, sizeof(i), &data, 10, test_del);
+        cache_add(high, &i, sizeof(i), &data, 10, test_del);
+    }
+    // Lower the budget by 150: the low priority cache is evicted first.
+    cache_set_budget(get_total_usage() - 150);
+    assert(low->size == 0 && high->size == 50);
+    assert(cache_get(high, &(int){5}, sizeof(int)));
+    assert(!cache_get(high, &(int){4}, sizeof(int)));
+    cache_set_budget(0);
+    cache_delete(low);
+    cache_delete(high);
+}
+
+static void bench_cache(void)
+{
+    bench_cache_n(10000);
+    bench_cache_n(100000);
+}
+
+TEST_REGISTER(NULL, bench_cache, 0);
+TEST_REGISTER(NULL, test_budget, TEST_AUTO);
+
+#endif
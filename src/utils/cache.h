@@ -7,6 +7,8 @@
  * repository.
  */
 
+#include <stdint.h>
+
 /*
  * File: cache.h
  *
@@ -82,3 +84,61 @@ void cache_set_cost(cache_t *cache, const void *key, int keylen, int cost);
  */
 int cache_get_current_size(const cache_t *cache);
 
+/*
+ * Function: cache_delete
+ * Delete a cache and all its items.
+ */
+void cache_delete(cache_t *cache);
+
+/*
+ * Function: cache_set_info
+ * Set the name and the priority of a cache for the global memory budget.
+ *
+ * Parameters:
+ *   name     - Name used in the memory usage report.  Not copied.
+ *   priority - When the memory budget is exceeded, the items of the caches
+ *              with the lowest priority are evicted first.  Default to 0.
+ */
+void cache_set_info(cache_t *cache, const char *name, int priority);
+
+/*
+ * Function: cache_set_budget
+ * Set the global memory budget shared by all the caches.
+ *
+ * When the total memory usage (all the caches plus the memory tracked with
+ * <cache_track_memory>) goes over the budget, items are evicted from the
+ * caches, lowest priority first.  The items still in their grace period
+ * are never evicted, so the budget can still be exceeded temporarily.
+ *
+ * The caches costs have to be in bytes for this to make sense.
+ *
+ * Parameters:
+ *   size - Budget in bytes, or zero to only use the caches max sizes.
+ */
+void cache_set_budget(int64_t size);
+
+/*
+ * Function: cache_track_memory
+ * Account for some memory not owned by a cache.
+ *
+ * This memory cannot be evicted, but it counts in the global budget, so
+ * the caches make room for it.
+ *
+ * Parameters:
+ *   name  - Name of the subsystem using the memory.  Not copied.
+ *   delta - Size in bytes allocated (positive) or released (negative).
+ */
+void cache_track_memory(const char *name, int64_t delta);
+
+/*
+ * Function: cache_get_memory_usage
+ * Return the total memory usage, as used for the global budget.
+ *
+ * Parameters:
+ *   user - User data passed to the callback.
+ *   f    - Optional callback called with the usage of each cache and
+ *          tracked subsystem.
+ */
+int64_t cache_get_memory_usage(
+        void *user, void (*f)(void *user, const char *name, int64_t size));
+
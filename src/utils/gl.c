@@ -7,6 +7,9 @@
  * repository.
  */
 
+// Not needed without OpenGL renderer.
+#ifndef RENDER_HEADLESS
+
 #include "gl.h"
 
 #include <assert.h>
@@ -414,3 +417,5 @@ void gl_update_uniform(gl_shader_t *shader, const char *name, ...)
     }
     va_end(args);
 }
+
+#endif // RENDER_HEADLESS
@@ -10,16 +10,21 @@
 #ifndef NO_LIBCURL
 
 #include "request.h"
+#include "uthash.h"
+#include "utlist.h"
 #include "utstring.h"
 
 #include <assert.h>
 #include <curl/curl.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <regex.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #ifndef LOG_E
 #   define LOG_E
@@ -31,32 +36,103 @@
 
 #define MAX_NB  16
 
+// Min time between two updates of the curl transfers (sec).
+#define UPDATE_INTERVAL (16.0 / 1000)
+
+// Max time spent processing the finished transfers per update (sec).
+#define DONE_BUDGET (4.0 / 1000)
+
+/*
+ * Disk cache
+ *
+ * The cached responses are stored in two files of the cache directory:
+ *
+ * - 'pack': the data of all the responses, appended one after the other.
+ *   The blocks are addressed by the hash of their content, so that the
+ *   identical responses are only stored once.
+ *
+ * - 'index': a header (CACHE_MAGIC, CACHE_VERSION), followed by an append
+ *   only list of records.  Each record is an index_record_t, followed by
+ *   the url and the etag strings.  The index is fully loaded in
+ *   request_init, the last record of an url replacing the previous ones,
+ *   so that a cache hit is only a hash table lookup.
+ *
+ * We still never clean the cache!
+ */
+
+#define CACHE_MAGIC "SWRI"
+#define CACHE_VERSION 1
+#define CACHE_HEADER_SIZE 8
+
+// Rewrite the index at init if it has more than this number of obsolete
+// records.
+#define CACHE_MAX_OBSOLETE 1024
+
+typedef struct {
+    uint32_t    url_len;
+    uint32_t    etag_len;
+    double      expiration;
+    uint64_t    hash;       // Hash of the data.
+    int64_t     ofs;        // Offset of the data in the pack.
+    int64_t     size;
+} index_record_t;
+
+typedef struct cache_entry cache_entry_t;
+struct cache_entry {
+    UT_hash_handle  hh;     // Keyed by url.
+    char            *url;
+    char            *etag;
+    double          expiration;
+    uint64_t        hash;
+    int64_t         ofs;
+    int             size;
+};
+
+// A data block of the pack.
+typedef struct pack_block pack_block_t;
+struct pack_block {
+    UT_hash_handle  hh;     // Keyed by hash.
+    uint64_t        hash;
+    int64_t         ofs;
+    int             size;
+};
+
 // static data.
 static struct {
     CURLM        *curlm;
     char         *cache_dir;
     int          nb; // Number of current running handles.
+    request_t    *queue; // Requests waiting for a free handle.
+
+    // Disk cache.
+    bool          cache_enabled;
+    int           index_fd;
+    int           pack_fd;
+    int64_t       pack_size;
+    cache_entry_t *entries;
+    pack_block_t  *blocks;
 } g = {};
 
 struct request
 {
+    request_t   *next, *prev;   // In the waiting queue.
     char        *url;
     CURL        *handle;
+    bool        queued;
+    double      priority;       // Lower first.
     UT_string   data_buf;       // Receive the data.
     UT_string   header_buf;     // Receive the header.
     long        status_code;    // HTTP status code
     void        *data;          // Actual data.
     int         size;
     bool        done;           // Request finished
-    char        *local_path;    // Data saved to this file
+    bool        from_cache;     // Data is in the disk cache.
 
     struct curl_slist *headers;
     char        *etag;
     double      expiration;     // Unix time expiration date.
 };
 
-static const char *request_get_file(request_t *req, int *status_code);
-
 static void *read_file(const char *path, int *size)
 {
     FILE *file;
@@ -86,16 +162,6 @@ static double get_unix_time(void)
     return tv.tv_sec + tv.tv_usec / 1000. / 1000.;
 }
 
-static bool file_exists(const char *path)
-{
-    FILE *file;
-    if ((file = fopen(path, "r"))) {
-        fclose(file);
-        return true;
-    }
-    return false;
-}
-
 /*
  * Create directories for a given file path.
  */
@@ -113,17 +179,264 @@ static int ensure_dir(const char *path)
     return 0;
 }
 
-static char *create_local_path(const char *url, const char *suffix)
+// FNV-1a hash of the responses data.
+static uint64_t data_hash(const void *data, int size)
+{
+    const uint8_t *p = data;
+    uint64_t ret = 14695981039346656037ULL;
+    int i;
+    for (i = 0; i < size; i++) {
+        ret ^= p[i];
+        ret *= 1099511628211ULL;
+    }
+    return ret;
+}
+
+static bool write_all(int fd, const void *data, int64_t size)
+{
+    ssize_t r;
+    while (size > 0) {
+        r = write(fd, data, size);
+        if (r == -1 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        data = (const char*)data + r;
+        size -= r;
+    }
+    return true;
+}
+
+static void cache_add_block(uint64_t hash, int64_t ofs, int size)
+{
+    pack_block_t *block;
+    HASH_FIND(hh, g.blocks, &hash, sizeof(hash), block);
+    if (!block) {
+        block = calloc(1, sizeof(*block));
+        block->hash = hash;
+        HASH_ADD(hh, g.blocks, hash, sizeof(block->hash), block);
+    }
+    block->ofs = ofs;
+    block->size = size;
+}
+
+static cache_entry_t *cache_add_entry(const char *url, const char *etag,
+                                      double expiration, uint64_t hash,
+                                      int64_t ofs, int size)
+{
+    cache_entry_t *entry;
+    HASH_FIND_STR(g.entries, url, entry);
+    if (!entry) {
+        entry = calloc(1, sizeof(*entry));
+        entry->url = strdup(url);
+        HASH_ADD_KEYPTR(hh, g.entries, entry->url, strlen(entry->url),
+                        entry);
+    }
+    if (entry->etag != etag) {
+        free(entry->etag);
+        entry->etag = strdup(etag);
+    }
+    entry->expiration = expiration;
+    entry->hash = hash;
+    entry->ofs = ofs;
+    entry->size = size;
+    cache_add_block(hash, ofs, size);
+    return entry;
+}
+
+static bool index_write(int fd, const cache_entry_t *entry)
 {
+    index_record_t rec = {
+        .url_len = strlen(entry->url),
+        .etag_len = strlen(entry->etag),
+        .expiration = entry->expiration,
+        .hash = entry->hash,
+        .ofs = entry->ofs,
+        .size = entry->size,
+    };
+    int size = sizeof(rec) + rec.url_len + rec.etag_len;
+    char *buf = malloc(size);
+    bool ret;
+
+    // Written at once so that we never get a partial record, except if
+    // we are interrupted.
+    memcpy(buf, &rec, sizeof(rec));
+    memcpy(buf + sizeof(rec), entry->url, rec.url_len);
+    memcpy(buf + sizeof(rec) + rec.url_len, entry->etag, rec.etag_len);
+    ret = write_all(fd, buf, size);
+    free(buf);
+    return ret;
+}
+
+static int open_file(const char *name, int flags)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", g.cache_dir, name);
+    return open(path, O_RDWR | O_CREAT | flags, 0644);
+}
+
+static void cache_release(void)
+{
+    cache_entry_t *entry, *tmp_entry;
+    pack_block_t *block, *tmp_block;
+
+    if (!g.cache_enabled) return;
+    close(g.index_fd);
+    close(g.pack_fd);
+    HASH_ITER(hh, g.entries, entry, tmp_entry) {
+        HASH_DEL(g.entries, entry);
+        free(entry->url);
+        free(entry->etag);
+        free(entry);
+    }
+    HASH_ITER(hh, g.blocks, block, tmp_block) {
+        HASH_DEL(g.blocks, block);
+        free(block);
+    }
+    g.cache_enabled = false;
+}
+
+/*
+ * Rewrite the index with only the current records.
+ */
+static void cache_compact(void)
+{
+    char path[PATH_MAX], tmp_path[PATH_MAX];
+    int fd;
+    bool ok = true;
+    cache_entry_t *entry;
+
+    snprintf(path, sizeof(path), "%s/index", g.cache_dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s/index.tmp", g.cache_dir);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return;
+    ok = write_all(fd, CACHE_MAGIC, 4);
+    ok = ok && write_all(fd, &(uint32_t){CACHE_VERSION}, 4);
+    for (entry = g.entries; ok && entry; entry = entry->hh.next)
+        ok = index_write(fd, entry);
+    close(fd);
+    if (!ok || rename(tmp_path, path) != 0) {
+        LOG_E("Cannot rewrite cache index");
+        unlink(tmp_path);
+        return;
+    }
+    close(g.index_fd);
+    g.index_fd = open_file("index", O_APPEND);
+}
+
+/*
+ * Load all the records of the index file.
+ *
+ * A record that points outside of the pack, or that was only partially
+ * written, and all the records after it are discarded.
+ */
+static void cache_load(void)
+{
+    char path[PATH_MAX], *data, *url, *etag;
+    int size = 0, nb_records = 0;
+    int64_t pos;
+    index_record_t rec;
+    uint32_t version = 0;
+
+    snprintf(path, sizeof(path), "%s/index", g.cache_dir);
+    ensure_dir(path);
+    g.pack_fd = open_file("pack", O_APPEND);
+    g.index_fd = open_file("index", O_APPEND);
+    if (g.pack_fd == -1 || g.index_fd == -1) {
+        LOG_E("Cannot open cache in %s", g.cache_dir);
+        if (g.pack_fd != -1) close(g.pack_fd);
+        if (g.index_fd != -1) close(g.index_fd);
+        return;
+    }
+    g.cache_enabled = true;
+    g.pack_size = lseek(g.pack_fd, 0, SEEK_END);
+
+    data = read_file(path, &size);
+    if (size >= CACHE_HEADER_SIZE) memcpy(&version, data + 4, 4);
+    if (    size < CACHE_HEADER_SIZE ||
+            memcmp(data, CACHE_MAGIC, 4) != 0 ||
+            version != CACHE_VERSION) {
+        if (ftruncate(g.index_fd, 0) != 0 ||
+                !write_all(g.index_fd, CACHE_MAGIC, 4) ||
+                !write_all(g.index_fd, &(uint32_t){CACHE_VERSION}, 4)) {
+            LOG_E("Cannot write cache index");
+        }
+        free(data);
+        return;
+    }
+
+    for (pos = CACHE_HEADER_SIZE; pos + sizeof(rec) <= size; ) {
+        memcpy(&rec, data + pos, sizeof(rec));
+        if (pos + sizeof(rec) + rec.url_len + rec.etag_len > size) break;
+        if (rec.ofs < 0 || rec.size < 0 || rec.size > INT32_MAX ||
+            rec.ofs + rec.size > g.pack_size) break;
+        url = strndup(data + pos + sizeof(rec), rec.url_len);
+        etag = strndup(data + pos + sizeof(rec) + rec.url_len, rec.etag_len);
+        cache_add_entry(url, etag, rec.expiration, rec.hash, rec.ofs,
+                        rec.size);
+        free(url);
+        free(etag);
+        pos += sizeof(rec) + rec.url_len + rec.etag_len;
+        nb_records++;
+    }
+    free(data);
+
+    // Remove any corrupted record, so that we can append after it.
+    if (pos < size && ftruncate(g.index_fd, pos) != 0)
+        LOG_E("Cannot truncate cache index");
+    if (nb_records - HASH_COUNT(g.entries) > CACHE_MAX_OBSOLETE)
+        cache_compact();
+}
+
+static void cache_save(request_t *req)
+{
+    const void *data = utstring_body(&req->data_buf);
+    uint64_t hash;
+    pack_block_t *block;
+    cache_entry_t *entry;
+
+    if (!g.cache_enabled) return;
+    hash = data_hash(data, req->size);
+    HASH_FIND(hh, g.blocks, &hash, sizeof(hash), block);
+    if (!block || block->size != req->size) {
+        if (!write_all(g.pack_fd, data, req->size)) {
+            LOG_E("Cannot write cache data");
+            // Some data might have been written.
+            g.pack_size = lseek(g.pack_fd, 0, SEEK_END);
+            return;
+        }
+        cache_add_block(hash, g.pack_size, req->size);
+        g.pack_size += req->size;
+        HASH_FIND(hh, g.blocks, &hash, sizeof(hash), block);
+    }
+    entry = cache_add_entry(req->url, req->etag, req->expiration, hash,
+                            block->ofs, block->size);
+    if (!index_write(g.index_fd, entry)) LOG_E("Cannot write cache index");
+}
+
+// Read the cached data of an url.  Return NULL if not in the cache.
+static void *cache_read(const char *url, int *size)
+{
+    cache_entry_t *entry;
     char *ret;
-    int i, r;
-    r = asprintf(&ret, "%s/%s%s", g.cache_dir, url, suffix ?: "");
-    if (r == -1) LOG_E("Error");
-    for (i = strlen(g.cache_dir) + 1; ret[i]; i++) {
-        if (ret[i] == '/' || ret[i] == ':')
-            ret[i] = '_';
+    ssize_t r;
+    int pos = 0;
+
+    if (!g.cache_enabled) return NULL;
+    HASH_FIND_STR(g.entries, url, entry);
+    if (!entry) return NULL;
+    // Always add a NULL byte at the end, for the text resources.
+    ret = malloc(entry->size + 1);
+    while (pos < entry->size) {
+        r = pread(g.pack_fd, ret + pos, entry->size - pos, entry->ofs + pos);
+        if (r == -1 && errno == EINTR) continue;
+        if (r <= 0) {
+            LOG_E("Cannot read cache data");
+            free(ret);
+            return NULL;
+        }
+        pos += r;
     }
-    ensure_dir(ret);
+    ret[entry->size] = '\0';
+    *size = entry->size;
     return ret;
 }
 
@@ -131,80 +444,78 @@ void request_init(const char *cache_dir)
 {
     assert(cache_dir);
     if (!g.curlm) g.curlm = curl_multi_init();
+    cache_release();
     free(g.cache_dir);
     g.cache_dir = strdup(cache_dir);
+    cache_load();
 }
 
 request_t *request_create(const char *url)
 {
-    char *local_path, *info_path;
-    char etag[128];
-    double expiration;
-    FILE *file;
-    int r;
+    cache_entry_t *entry = NULL;
     request_t *req = calloc(1, sizeof(*req));
     req->url = strdup(url);
 
     assert(strchr(url, ':')); // Make sure we have a protocol.
 
     // Check for cache info.
-    local_path = create_local_path(url, NULL);
-    info_path = create_local_path(url, ".info");
-    if (file_exists(local_path) && file_exists(info_path)) {
-        file = fopen(info_path, "r");
-        r = fscanf(file, "etag: %s\n", etag);
-        if (r == 1) req->etag = strdup(etag);
-        r = fscanf(file, "expiration: %lf\n", &expiration);
-        if (r == 1) req->expiration = expiration;
-        fclose(file);
-
+    if (g.cache_enabled) HASH_FIND_STR(g.entries, url, entry);
+    if (entry) {
+        req->etag = strdup(entry->etag);
+        req->expiration = entry->expiration;
         // If the cached version is not expired yet just use it.
         if (req->expiration && req->expiration > get_unix_time()) {
-            req->local_path = strdup(local_path);
+            req->from_cache = true;
             req->status_code = 200;
             req->done = true;
         }
     }
-
-    free(local_path);
-    free(info_path);
     return req;
 }
 
 int request_is_finished(const request_t *req)
 {
-    return req->handle == NULL;
+    return req->done;
+}
+
+void request_set_priority(request_t *req, double priority)
+{
+    req->priority = priority;
+}
+
+void request_cancel(request_t *req)
+{
+    if (req->queued) {
+        DL_DELETE(g.queue, req);
+        req->queued = false;
+    }
+    if (!req->handle) return;
+    curl_multi_remove_handle(g.curlm, req->handle);
+    curl_easy_cleanup(req->handle);
+    req->handle = NULL;
+    g.nb--;
+    // Reset the buffers, so that the request can be started again.
+    utstring_done(&req->data_buf);
+    utstring_done(&req->header_buf);
+    memset(&req->data_buf, 0, sizeof(req->data_buf));
+    memset(&req->header_buf, 0, sizeof(req->header_buf));
+    if (req->headers) curl_slist_free_all(req->headers);
+    req->headers = NULL;
 }
 
 void request_delete(request_t *req)
 {
     if (!req) return;
-    if (req->handle) LOG_E("Aborting request not implemented yet!");
+    request_cancel(req);
     if (req->data != utstring_body(&req->data_buf)) free(req->data);
     utstring_done(&req->data_buf);
     utstring_done(&req->header_buf);
     free(req->url);
-    free(req->local_path);
     free(req->etag);
     if (req->headers) curl_slist_free_all(req->headers);
     free(req);
 }
 
-static void save_cache(const char *url, const char *path, const char *etag,
-                       double expiration)
-{
-    char *info_path;
-    FILE *file;
-    int r;
-    r = asprintf(&info_path, "%s.info", path);
-    if (r == -1) LOG_E("Error");
-    file = fopen(info_path, "w");
-    fprintf(file, "etag: %s\n", etag);
-    fprintf(file, "expiration: %.0f\n", expiration);
-    fclose(file);
-    free(info_path);
-}
-
 static bool header_find(const char *header, const char *re,
                         char *buf, int buf_size)
 {
@@ -231,14 +542,10 @@ static void on_done(request_t *req)
 {
     char buf[128] = {};
     const char *header;
-    const char *path;
-
-    assert(!req->local_path);
 
     // The resource didn't change.
     if (req->status_code / 100 == 3) {
-        req->local_path = create_local_path(req->url, NULL);
-        assert(file_exists(req->local_path));
+        req->from_cache = true;
     }
 
     if (req->status_code / 100 != 2) goto end;
@@ -254,56 +561,36 @@ static void on_done(request_t *req)
         req->expiration = get_unix_time() + atof(buf);
     }
     // For the moment we save all the files in the cache as long as they
-    // have an etag.  We also never clean the cache!
-    if (req->etag) {
-        path = request_get_file(req, NULL);
-        save_cache(req->url, path, req->etag, req->expiration);
-    }
+    // have an etag.
+    if (req->etag) cache_save(req);
 
 end:
     return;
 }
 
-static void update(void)
+static void on_transfer_done(CURLMsg *msg)
 {
-    int nb, msgs_in_queue;
-    CURLMsg *msg;
-    CURL *handle;
+    CURL *handle = msg->easy_handle;
     request_t *req;
-    static double last = 0;
-
-    // Avoid loading too many resources too fast to keep a good framerate.
-    if ((get_unix_time() - last) < 16.0 / 1000) return;
 
-    assert(g.curlm);
-    curl_multi_perform(g.curlm, &nb);
-    if (nb == g.nb) return;
-    while ((msg = curl_multi_info_read(g.curlm, &msgs_in_queue))) {
-        if (msg->msg == CURLMSG_DONE) {
-            handle = msg->easy_handle;
-            curl_easy_getinfo(handle, CURLINFO_PRIVATE, (char**)&req);
-            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE,
-                                      &req->status_code);
-            // Convention: returns a server timeout if the connection failed.
-            if (!req->status_code && msg->data.result)
-                req->status_code = 598;
-            g.nb--;
-            curl_multi_remove_handle(g.curlm, handle);
-            curl_easy_cleanup(handle);
-            req->handle = NULL;
-            req->done = true;
-            if (req->status_code / 100 == 2) {
-                req->size = utstring_len(&req->data_buf);
-                // Add a 0 byte at the end of the data, this is useful for
-                // text resources.
-                utstring_bincpy(&req->data_buf, "", 1);
-                req->data = utstring_body(&req->data_buf);
-            }
-            on_done(req);
-            last = get_unix_time();
-            break;
-        }
+    curl_easy_getinfo(handle, CURLINFO_PRIVATE, (char**)&req);
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &req->status_code);
+    // Convention: returns a server timeout if the connection failed.
+    if (!req->status_code && msg->data.result)
+        req->status_code = 598;
+    g.nb--;
+    curl_multi_remove_handle(g.curlm, handle);
+    curl_easy_cleanup(handle);
+    req->handle = NULL;
+    req->done = true;
+    if (req->status_code / 100 == 2) {
+        req->size = utstring_len(&req->data_buf);
+        // Add a 0 byte at the end of the data, this is useful for
+        // text resources.
+        utstring_bincpy(&req->data_buf, "", 1);
+        req->data = utstring_body(&req->data_buf);
     }
+    on_done(req);
 }
 
 static size_t write_callback(
@@ -315,72 +602,107 @@ static size_t write_callback(
     return len;
 }
 
-static void req_update(request_t *req)
+static void req_start(request_t *req)
 {
     int r;
     char *tmp;
-    assert(g.curlm); // Check that request_init was called!
-    if (req->done) return;
-    if (!req->handle && g.nb < MAX_NB) {
-        req->handle = curl_easy_init();
-        utstring_init(&req->data_buf);
-        utstring_init(&req->header_buf);
-        curl_easy_setopt(req->handle, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(req->handle, CURLOPT_WRITEDATA, &req->data_buf);
-        curl_easy_setopt(req->handle, CURLOPT_HEADERDATA, &req->header_buf);
-        curl_easy_setopt(req->handle, CURLOPT_URL, req->url);
-        curl_easy_setopt(req->handle, CURLOPT_FAILONERROR, 1);
-        curl_easy_setopt(req->handle, CURLOPT_PRIVATE, req);
-        curl_easy_setopt(req->handle, CURLOPT_FOLLOWLOCATION, 1);
-        curl_easy_setopt(req->handle, CURLOPT_SSL_VERIFYPEER, 0);
-        curl_easy_setopt(req->handle, CURLOPT_SSL_VERIFYHOST, 0);
-        // curl_easy_setopt(req->handle, CURLOPT_VERBOSE, 1);
-        if (req->etag) {
-            r = asprintf(&tmp, "If-None-Match: \"%s\"", req->etag);
-            if (r == -1) LOG_E("Error");
-            req->headers = curl_slist_append(req->headers, tmp);
-            free(tmp);
-        }
-        if (req->headers)
-            curl_easy_setopt(req->handle, CURLOPT_HTTPHEADER, req->headers);
 
-        curl_multi_add_handle(g.curlm, req->handle);
-        g.nb++;
+    req->handle = curl_easy_init();
+    utstring_init(&req->data_buf);
+    utstring_init(&req->header_buf);
+    curl_easy_setopt(req->handle, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(req->handle, CURLOPT_WRITEDATA, &req->data_buf);
+    curl_easy_setopt(req->handle, CURLOPT_HEADERDATA, &req->header_buf);
+    curl_easy_setopt(req->handle, CURLOPT_URL, req->url);
+    curl_easy_setopt(req->handle, CURLOPT_FAILONERROR, 1);
+    curl_easy_setopt(req->handle, CURLOPT_PRIVATE, req);
+    curl_easy_setopt(req->handle, CURLOPT_FOLLOWLOCATION, 1);
+    curl_easy_setopt(req->handle, CURLOPT_SSL_VERIFYPEER, 0);
+    curl_easy_setopt(req->handle, CURLOPT_SSL_VERIFYHOST, 0);
+    // curl_easy_setopt(req->handle, CURLOPT_VERBOSE, 1);
+    if (req->etag) {
+        r = asprintf(&tmp, "If-None-Match: \"%s\"", req->etag);
+        if (r == -1) LOG_E("Error");
+        req->headers = curl_slist_append(req->headers, tmp);
+        free(tmp);
     }
+    if (req->headers)
+        curl_easy_setopt(req->handle, CURLOPT_HTTPHEADER, req->headers);
 
-    update();
+    curl_multi_add_handle(g.curlm, req->handle);
+    g.nb++;
 }
 
-static const char *request_get_file(request_t *req, int *status_code)
+/*
+ * Start the queued requests with the lowest priority values, as long as
+ * we have free handles.
+ */
+static void start_queued(void)
 {
-    FILE *file;
-    if (!req->local_path) {
-        req_update(req);
-        if (req->done && req->status_code / 100 == 2) {
-            req->local_path = create_local_path(req->url, NULL);
-            file = fopen(req->local_path, "wb");
-            if (!file) perror(NULL);
-            assert(file);
-            fwrite(utstring_body(&req->data_buf), 1, req->size, file);
-            fclose(file);
+    request_t *req, *best;
+    while (g.queue && g.nb < MAX_NB) {
+        best = g.queue;
+        DL_FOREACH(g.queue, req) {
+            if (req->priority < best->priority) best = req;
         }
+        DL_DELETE(g.queue, best);
+        best->queued = false;
+        req_start(best);
     }
-    if (status_code) *status_code = req->status_code;
-    return req->local_path;
+}
+
+static void update(void)
+{
+    int nb, msgs_in_queue;
+    CURLMsg *msg;
+    double start;
+    static double last = 0;
+
+    // Avoid spending too much time in curl to keep a good framerate.
+    start = get_unix_time();
+    if (start - last < UPDATE_INTERVAL) return;
+    last = start;
+
+    assert(g.curlm);
+    start_queued();
+    curl_multi_perform(g.curlm, &nb);
+    if (nb == g.nb) return;
+    // Process all the finished transfers, as long as we stay in the time
+    // budget.  The remaining ones are kept by curl for the next update.
+    // The budget starts after curl_multi_perform, so that a slow perform
+    // doesn't delay the finished transfers forever.
+    start = get_unix_time();
+    while (get_unix_time() - start < DONE_BUDGET &&
+           (msg = curl_multi_info_read(g.curlm, &msgs_in_queue))) {
+        if (msg->msg == CURLMSG_DONE) on_transfer_done(msg);
+    }
+}
+
+static void req_update(request_t *req)
+{
+    assert(g.curlm); // Check that request_init was called!
+    if (req->done) return;
+    if (!req->handle && !req->queued) {
+        DL_APPEND(g.queue, req);
+        req->queued = true;
+    }
+    update();
 }
 
 const void *request_get_data(request_t *req, int *size, int *status_code)
 {
     req_update(req);
+    // Cached response, read it from the pack.
+    if (req->done && !req->data && req->from_cache) {
+        req->data = cache_read(req->url, &req->size);
+        req->from_cache = false;
+        if (!req->data) req->status_code = 598;
+    }
     if (status_code) *status_code = req->status_code;
     if (!req->done) {
         if (size) *size = 0;
         return NULL;
     }
-    // Local file, copy it into the data buffer.
-    if (!req->data && req->local_path) {
-        req->data = read_file(req->local_path, &req->size);
-    }
     if (size) *size = req->size;
     return req->data;
 }
@@ -396,6 +718,7 @@ void request_make_fresh(request_t *req)
 #ifdef REQUEST_DUMMY
 
 #include "request.h"
+#include <stdbool.h>
 #include <stdlib.h>
 
 struct request
@@ -420,6 +743,15 @@ void request_delete(request_t *req)
 {
     free(req);
 }
+
+void request_set_priority(request_t *req, double priority)
+{
+}
+
+void request_cancel(request_t *req)
+{
+}
+
 const void *request_get_data(request_t *req, int *size, int *status_code)
 {
     *size = 0;
@@ -427,6 +759,10 @@ const void *request_get_data(request_t *req, int *size, int *status_code)
     return NULL;
 }
 
+void request_make_fresh(request_t *req)
+{
+}
+
 #endif // REQUEST_DUMMY
 
 #endif // NO_LIBCURL
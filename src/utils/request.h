@@ -14,6 +14,10 @@ void request_init(const char *cache_dir);
 request_t *request_create(const char *url);
 int request_is_finished(const request_t *req);
 void request_delete(request_t *req);
+// Lower values are started first when all the connections are busy.
+void request_set_priority(request_t *req, double priority);
+// Abort the transfer if running.  Getting the data again restarts it.
+void request_cancel(request_t *req);
 const void *request_get_data(request_t *req, int *size, int *status_code);
 // Don't use cache even if we have a local copy.
 void request_make_fresh(request_t *req);
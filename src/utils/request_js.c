@@ -15,8 +15,11 @@
 
 struct request
 {
+    request_t   *next, *prev;   // In the waiting queue.
     char        *url;
     int         handle;
+    bool        queued;
+    double      priority;       // Lower first.
     int         status_code;
     bool        done;
     void        *data;
@@ -26,6 +29,7 @@ struct request
 
 static struct {
     int nb;     // Number of current running requests.
+    request_t *queue; // Requests waiting for a free slot.
 } g = {};
 
 static bool url_has_extension(const char *str, const char *ext);
@@ -52,13 +56,28 @@ int request_is_finished(const request_t *req)
     return req->done;
 }
 
-void request_delete(request_t *req)
+void request_set_priority(request_t *req, double priority)
 {
-    if (!req) return;
+    req->priority = priority;
+}
+
+void request_cancel(request_t *req)
+{
+    if (req->queued) {
+        DL_DELETE(g.queue, req);
+        req->queued = false;
+    }
     if (req->handle) {
         emscripten_async_wget2_abort(req->handle - 1);
+        req->handle = 0;
         g.nb--;
     }
+}
+
+void request_delete(request_t *req)
+{
+    if (!req) return;
+    request_cancel(req);
     free(req->url);
     free(req->data);
     free(req);
@@ -124,16 +143,36 @@ static void onprogress(unsigned int _, void *arg, int nb_bytes, int size)
 {
 }
 
-const void *request_get_data(request_t *req, int *size, int *status_code)
+/*
+ * Start the queued requests with the lowest priority values, as long as
+ * we have free slots.
+ */
+static void start_queued(void)
 {
     int handle;
-    if (!req->done && !req->handle && g.nb < MAX_NB) {
+    request_t *req, *best;
+    while (g.queue && g.nb < MAX_NB) {
+        best = g.queue;
+        DL_FOREACH(g.queue, req) {
+            if (req->priority < best->priority) best = req;
+        }
+        DL_DELETE(g.queue, best);
+        best->queued = false;
         handle = emscripten_async_wget2_data(
-                req->url, "GET", NULL, req, false,
+                best->url, "GET", NULL, best, false,
                 onload, onerror, onprogress);
-        req->handle = handle + 1; // So that we cannot get 0.
+        best->handle = handle + 1; // So that we cannot get 0.
         g.nb++;
     }
+}
+
+const void *request_get_data(request_t *req, int *size, int *status_code)
+{
+    if (!req->done && !req->handle && !req->queued) {
+        DL_APPEND(g.queue, req);
+        req->queued = true;
+    }
+    start_queued();
     if (size) *size = req->size;
     if (status_code) *status_code= req->status_code;
     return req->data;
@@ -8,6 +8,7 @@
  */
 
 #include "texture.h"
+#include "cache.h"
 #include "gl.h"
 
 #include <assert.h>
@@ -38,6 +39,18 @@ static void blit(const uint8_t *src, int src_w, int src_h, int bpp,
     }
 }
 
+// Create the texture OpenGL id.
+static void gen_texture(uint32_t *id)
+{
+#ifdef RENDER_HEADLESS
+    // No OpenGL context, we only need unique non zero ids.
+    static uint32_t last_id = 0;
+    *id = ++last_id;
+#else
+    GL(glGenTextures(1, id));
+#endif
+}
+
 void texture_set_load_callback(void *user,
         uint8_t *(*load)(void *user, const char *url, int *code,
                          int *w, int *h, int *bpp))
@@ -46,20 +59,13 @@ void texture_set_load_callback(void *user,
     g_callback.load = load;
 }
 
-void texture_set_data(texture_t *tex, const void *data, int w, int h, int bpp)
+#ifndef RENDER_HEADLESS
+// Upload the texture data to the GPU.
+static void upload_data(texture_t *tex, const void *data, int w, int h,
+                        int bpp)
 {
     uint8_t *buff0 = NULL;
-    int data_type = GL_UNSIGNED_BYTE;
-    assert(tex->id);
-
-    tex->w = w;
-    tex->h = h;
-    tex->tex_w = next_pow2(w);
-    tex->tex_h = next_pow2(h);
-    tex->format = (int[]){
-        0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA
-    }[bpp];
-    assert(tex->format);
+    int data_type = GL_UNSIGNED_BYTE, size;
 
     if (!is_pow2(w) || !is_pow2(h)) {
         buff0 = calloc(bpp, tex->tex_w * tex->tex_h);
@@ -79,6 +85,31 @@ void texture_set_data(texture_t *tex, const void *data, int w, int h, int bpp)
 
     if (tex->flags & TF_MIPMAP)
         GL(glGenerateMipmap(GL_TEXTURE_2D));
+
+    // Account for the GPU memory, with an extra third for the mipmaps.
+    size = tex->tex_w * tex->tex_h * bpp;
+    if (tex->flags & TF_MIPMAP) size += size / 3;
+    cache_track_memory("textures", size - tex->mem_size);
+    tex->mem_size = size;
+}
+#endif
+
+void texture_set_data(texture_t *tex, const void *data, int w, int h, int bpp)
+{
+    assert(tex->id);
+
+    tex->w = w;
+    tex->h = h;
+    tex->tex_w = next_pow2(w);
+    tex->tex_h = next_pow2(h);
+    tex->format = (int[]){
+        0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA
+    }[bpp];
+    assert(tex->format);
+
+#ifndef RENDER_HEADLESS
+    upload_data(tex, data, w, h, bpp);
+#endif
 }
 
 texture_t *texture_create(int w, int h, int bpp)
@@ -91,7 +122,7 @@ texture_t *texture_create(int w, int h, int bpp)
     tex->w = w;
     tex->h = h;
     tex->format = (int[]){0, 0, 0, GL_RGB, GL_RGBA}[bpp];
-    GL(glGenTextures(1, &tex->id));
+    gen_texture(&tex->id);
     return tex;
 }
 
@@ -101,7 +132,10 @@ void texture_release(texture_t *tex)
     tex->ref--;
     if (tex->ref) return;
     free(tex->url);
+    cache_track_memory("textures", -tex->mem_size);
+#ifndef RENDER_HEADLESS
     if (tex->id) GL(glDeleteTextures(1, &tex->id));
+#endif
     free(tex);
 }
 
@@ -115,7 +149,7 @@ texture_t *texture_from_data(const void *data, int img_w, int img_h, int bpp,
     tex = calloc(1, sizeof(*tex));
     tex->ref = 1;
     tex->flags = flags;
-    GL(glGenTextures(1, &tex->id));
+    gen_texture(&tex->id);
 
     if (x != 0 || y != 0 || w != img_w || h != img_h) {
         img = calloc(w * h, bpp);
@@ -149,7 +183,7 @@ bool texture_load(texture_t *tex, int *code)
     assert(g_callback.load);
     img = g_callback.load(g_callback.user, tex->url, code, &w, &h, &bpp);
     if (!img) return false;
-    GL(glGenTextures(1, &tex->id));
+    gen_texture(&tex->id);
     texture_set_data(tex, img, w, h, bpp);
     free(img);
     return true;
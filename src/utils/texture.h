@@ -43,6 +43,7 @@ typedef struct texture {
     int             format;
     int             flags;
     char            *url;
+    int             mem_size;   // Estimated GPU memory, in bytes.
 } texture_t;
 
 /*
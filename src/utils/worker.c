@@ -31,4 +31,179 @@ bool worker_is_running(worker_t *w)
     return false;
 }
 
-#endif
+void worker_pool_init(int nb_threads)
+{
+}
+
+void worker_pool_release(void)
+{
+}
+
+#else // HAVE_PTHREAD
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Max number of workers waiting to be run.  If the queue is full,
+// worker_iter just returns 0 and the caller will try again later.
+#define QUEUE_SIZE 256
+
+// Max number of threads in the pool.
+#define MAX_THREADS 32
+
+// Worker states.  Zero and one keep the same meaning as in the non threaded
+// version (not started / done).
+enum {
+    STATE_INIT      = 0,
+    STATE_DONE      = 1,
+    STATE_QUEUED    = 2,
+    STATE_RUNNING   = 3,
+};
+
+// static data.
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    pthread_t       threads[MAX_THREADS];
+    int             nb_threads;
+    bool            started;
+    bool            quit;
+    // Ring buffer of queued workers.
+    worker_t        *queue[QUEUE_SIZE];
+    int             queue_start;
+    int             queue_len;
+} g = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *thread_func(void *arg)
+{
+    worker_t *w;
+    pthread_mutex_lock(&g.mutex);
+    while (true) {
+        while (!g.queue_len && !g.quit)
+            pthread_cond_wait(&g.cond, &g.mutex);
+        // Even when quitting, we first run all the queued workers, so that
+        // none stays in the queued state forever.
+        if (!g.queue_len) break;
+        w = g.queue[g.queue_start];
+        g.queue_start = (g.queue_start + 1) % QUEUE_SIZE;
+        g.queue_len--;
+        w->state = STATE_RUNNING;
+        pthread_mutex_unlock(&g.mutex);
+
+        w->ret = w->fn(w);
+
+        pthread_mutex_lock(&g.mutex);
+        w->state = STATE_DONE;
+    }
+    pthread_mutex_unlock(&g.mutex);
+    return NULL;
+}
+
+// Start the threads.  Should be called with the mutex locked.
+static void pool_start(void)
+{
+    int i, r;
+    if (g.started) return;
+    if (!g.nb_threads)
+        g.nb_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    g.nb_threads = g.nb_threads < 1 ? 1 :
+                   g.nb_threads > MAX_THREADS ? MAX_THREADS : g.nb_threads;
+    g.quit = false;
+    for (i = 0; i < g.nb_threads; i++) {
+        r = pthread_create(&g.threads[i], NULL, thread_func, NULL);
+        if (r) {
+            LOG_E("Cannot create worker thread: %d", r);
+            break;
+        }
+    }
+    g.nb_threads = i;
+    g.started = true;
+}
+
+void worker_pool_init(int nb_threads)
+{
+    pthread_mutex_lock(&g.mutex);
+    if (g.started)
+        LOG_W("Worker pool already started, ignore nb threads change");
+    else
+        g.nb_threads = nb_threads;
+    pthread_mutex_unlock(&g.mutex);
+}
+
+void worker_pool_release(void)
+{
+    int i;
+    pthread_mutex_lock(&g.mutex);
+    if (!g.started) {
+        pthread_mutex_unlock(&g.mutex);
+        return;
+    }
+    g.quit = true;
+    pthread_cond_broadcast(&g.cond);
+    pthread_mutex_unlock(&g.mutex);
+
+    for (i = 0; i < g.nb_threads; i++)
+        pthread_join(g.threads[i], NULL);
+
+    pthread_mutex_lock(&g.mutex);
+    assert(g.queue_len == 0);
+    g.started = false;
+    g.nb_threads = 0;
+    pthread_mutex_unlock(&g.mutex);
+}
+
+void worker_init(worker_t *w, int (*fn)(worker_t *w))
+{
+    memset(w, 0, sizeof(*w));
+    w->fn = fn;
+}
+
+int worker_iter(worker_t *w)
+{
+    int ret = 0;
+    pthread_mutex_lock(&g.mutex);
+    pool_start();
+    switch (w->state) {
+    case STATE_DONE:
+        ret = 1;
+        break;
+    case STATE_INIT:
+        // If we could not start any thread, or if we are shutting down,
+        // just run the function directly.
+        if (!g.nb_threads || g.quit) {
+            w->state = STATE_RUNNING;
+            pthread_mutex_unlock(&g.mutex);
+            w->ret = w->fn(w);
+            pthread_mutex_lock(&g.mutex);
+            w->state = STATE_DONE;
+            ret = 1;
+            break;
+        }
+        if (g.queue_len >= QUEUE_SIZE) break; // Queue full, retry later.
+        g.queue[(g.queue_start + g.queue_len) % QUEUE_SIZE] = w;
+        g.queue_len++;
+        w->state = STATE_QUEUED;
+        pthread_cond_signal(&g.cond);
+        break;
+    default:
+        break;
+    }
+    pthread_mutex_unlock(&g.mutex);
+    return ret;
+}
+
+bool worker_is_running(worker_t *w)
+{
+    bool ret;
+    pthread_mutex_lock(&g.mutex);
+    ret = w->state == STATE_QUEUED || w->state == STATE_RUNNING;
+    pthread_mutex_unlock(&g.mutex);
+    return ret;
+}
+
+#endif // HAVE_PTHREAD
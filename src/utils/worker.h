@@ -14,6 +14,10 @@
  * A worker is simply a task that run in a thread pool.  We can create a worker
  * with <worker_init> and then run it by calling <worker_iter> as many times
  * as we want, until it returns a non zero value.
+ *
+ * If HAVE_PTHREAD is defined, the workers are run by a fixed size pool of
+ * threads with a bounded queue.  Otherwise the worker function is called
+ * directly from <worker_iter>.
  */
 
 #ifndef WORKER_H
@@ -59,4 +63,30 @@ int worker_iter(worker_t *worker);
  */
 bool worker_is_running(worker_t *worker);
 
+/*
+ * Function: worker_pool_init
+ * Set the number of threads used by the worker pool.
+ *
+ * This should be called before any worker is started, otherwise it has no
+ * effect: to change it later, first stop the pool with
+ * <worker_pool_release>.  If not called, the pool uses one thread less than
+ * the number of available cpus.  Does nothing if we don't have threads
+ * support.
+ *
+ * The core 'worker_threads' attribute uses this.
+ *
+ * Parameters:
+ *   nb_threads - Number of threads, or zero to use the default value.
+ */
+void worker_pool_init(int nb_threads);
+
+/*
+ * Function: worker_pool_release
+ * Stop all the threads of the worker pool.
+ *
+ * Any worker still in the queue is run before the threads exit.  The pool
+ * is automatically restarted if <worker_iter> is called again later.
+ */
+void worker_pool_release(void);
+
 #endif // WORKER_H
@@ -0,0 +1,321 @@
+/* Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+ *
+ * This program is licensed under the terms of the GNU AGPL v3, or
+ * alternatively under a commercial licence.
+ *
+ * The terms of the AGPL v3 license can be found in the main directory of this
+ * repository.
+ */
+
+/*
+ * Native frame time benchmark.
+ *
+ * Load the test sky data, replay a camera path with the headless renderer,
+ * and print the time spent in each module update and render (percentiles
+ * over all the frames), as well as the number of heap allocations per
+ * frame.
+ *
+ * Build with 'scons bench=1', then run from the repo root:
+ *
+ *   ./build/swe-bench [-p path_file] [-w warmup_sec] [-c tiles_cache_dir]
+ *                     [skydata_dir]
+ *
+ * The path file contains one key frame per line:
+ *
+ *   <nb_frames> <yaw (deg)> <pitch (deg)> <fov (deg)> [utc (MJD)]
+ *
+ * The camera moves linearly from the previous key frame to this one in
+ * nb_frames frames.  We don't use the core animations so that the rendered
+ * frames don't depend on the machine speed.
+ *
+ * With -c, the decoded tiles disk cache is enabled in the given directory
+ * (see hips_set_tile_cache_dir), and the warm up time is printed, so that
+ * we can compare a cold and a warm start.
+ */
+
+#include "swe.h"
+#include "render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Used if no path file is given.
+static const char *DEFAULT_PATH =
+    "# frames  yaw   pitch  fov    utc\n"
+    "  1       0     30     120    59000.8\n"
+    "  120     90    45     60\n"
+    "  120     180   20     5\n"
+    "  60      180   20     0.5\n"
+    "  120     270   60     90     59001.3\n"
+    "  120     360   80     180\n";
+
+typedef struct {
+    int     nb_frames;
+    double  yaw, pitch, fov; // Degrees.
+    double  utc;             // MJD, or NAN to keep the current time.
+} keyframe_t;
+
+// Values recorded for a single frame.
+typedef struct {
+    double  update_time;
+    double  render_time;
+    int     nb_allocs;
+    // Update / render times of the modules, indexed as g.modules.  The
+    // modules added after this frame are not in the array.
+    int     nb_modules;
+    double  *modules_times;
+} frame_t;
+
+static struct {
+    long nb_allocs; // Number of heap allocations so far.
+    // Names of all the modules seen so far, in order of appearance.
+    int  nb_modules;
+    char **modules;
+} g;
+
+/*
+ * Count the heap allocations.  The binary is linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so that all the calls
+ * from the engine end up here.
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&g.nb_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    __atomic_add_fetch(&g.nb_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&g.nb_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+static int parse_path(const char *str, keyframe_t **out)
+{
+    const char *line;
+    keyframe_t k, *ret = NULL;
+    int n = 0, r;
+
+    for (line = str; line && *line; line = strchr(line, '\n')) {
+        if (*line == '\n') line++;
+        k.utc = NAN;
+        r = sscanf(line, "%d %lf %lf %lf %lf", &k.nb_frames, &k.yaw,
+                   &k.pitch, &k.fov, &k.utc);
+        if (r < 4) continue; // Comment or empty line.
+        ret = realloc(ret, (n + 1) * sizeof(*ret));
+        ret[n++] = k;
+    }
+    *out = ret;
+    return n;
+}
+
+static void add_source(const char *dir, const char *module, const char *path,
+                       const char *key)
+{
+    char url[1024];
+    snprintf(url, sizeof(url), "%s/%s", dir, path);
+    module_add_data_source(core_get_module(module), url, key);
+}
+
+static void on_progressbar(void *user, const char *id, const char *label,
+                           int v, int total, int error, const char *error_msg)
+{
+}
+
+static void set_view(const keyframe_t *k)
+{
+    double pos[3];
+    eraS2c(k->yaw * DD2R, k->pitch * DD2R, pos);
+    core_lookat(pos, 0);
+    core_zoomto(k->fov * DD2R, 0);
+    if (!isnan(k->utc)) core_set_time(k->utc, 0);
+}
+
+// Return the index of a module in g.modules, adding it if needed.
+static int get_module_index(const char *name)
+{
+    int i;
+    for (i = 0; i < g.nb_modules; i++) {
+        if (strcmp(g.modules[i], name) == 0) return i;
+    }
+    g.modules = realloc(g.modules, (g.nb_modules + 1) * sizeof(*g.modules));
+    g.modules[g.nb_modules] = strdup(name);
+    return g.nb_modules++;
+}
+
+static void render_frame(frame_t *frame)
+{
+    int i, j;
+    long nb_allocs = g.nb_allocs;
+    double t0, t1, t2;
+
+    t0 = sys_get_unix_time();
+    core_update();
+    t1 = sys_get_unix_time();
+    core_render(core->win_size[0], core->win_size[1], 1);
+    t2 = sys_get_unix_time();
+    if (!frame) return;
+    frame->update_time = t1 - t0;
+    frame->render_time = t2 - t1;
+    frame->nb_allocs = g.nb_allocs - nb_allocs;
+    for (i = 0; i < core->nb_modules; i++)
+        get_module_index(core->modules_stats[i].module->id ?: "?");
+    frame->nb_modules = g.nb_modules;
+    frame->modules_times = calloc(g.nb_modules * 2, sizeof(double));
+    for (i = 0; i < core->nb_modules; i++) {
+        j = get_module_index(core->modules_stats[i].module->id ?: "?");
+        frame->modules_times[j * 2 + 0] = core->modules_stats[i].update_time;
+        frame->modules_times[j * 2 + 1] = core->modules_stats[i].render_time;
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    return cmp(*(const double*)a, *(const double*)b);
+}
+
+// Print the p50, p90, p99 and max values of a list, multiplied by scale.
+static void print_percentiles(const char *name, int n, double *values,
+                              double scale)
+{
+    qsort(values, n, sizeof(*values), cmp_double);
+    printf("%-24s %9.3f %9.3f %9.3f %9.3f\n", name,
+           values[n * 50 / 100] * scale, values[n * 90 / 100] * scale,
+           values[n * 99 / 100] * scale, values[n - 1] * scale);
+}
+
+static void print_report(int nb_frames, frame_t *frames)
+{
+    int i, j;
+    double *values = calloc(nb_frames, sizeof(*values));
+    char name[128];
+
+    printf("%d frames\n", nb_frames);
+    printf("%-24s %9s %9s %9s %9s\n", "(ms)", "p50", "p90", "p99", "max");
+    for (i = 0; i < nb_frames; i++) values[i] = frames[i].update_time;
+    print_percentiles("update", nb_frames, values, 1000);
+    for (i = 0; i < nb_frames; i++) values[i] = frames[i].render_time;
+    print_percentiles("render", nb_frames, values, 1000);
+
+    for (j = 0; j < g.nb_modules * 2; j++) {
+        snprintf(name, sizeof(name), "  %s.%s", g.modules[j / 2],
+                 j % 2 ? "render" : "update");
+        // Zero for the frames before the module was added.
+        for (i = 0; i < nb_frames; i++) {
+            values[i] = j < frames[i].nb_modules * 2 ?
+                        frames[i].modules_times[j] : 0;
+        }
+        qsort(values, nb_frames, sizeof(*values), cmp_double);
+        if (values[nb_frames - 1] == 0) continue; // Never takes any time.
+        print_percentiles(name, nb_frames, values, 1000);
+    }
+
+    for (i = 0; i < nb_frames; i++) values[i] = frames[i].nb_allocs;
+    print_percentiles("allocs (count)", nb_frames, values, 1);
+    free(values);
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = "apps/test-skydata";
+    char *path_str = NULL;
+    keyframe_t *keys, k;
+    frame_t *frames;
+    int i, j, nb_keys, nb_frames = 0, opt;
+    double t, warmup = 5;
+    const char *tiles_cache_dir = NULL;
+
+    while ((opt = getopt(argc, argv, "p:w:c:")) != -1) {
+        switch (opt) {
+        case 'p':
+            path_str = read_file(optarg, NULL);
+            if (!path_str) {
+                fprintf(stderr, "Cannot read %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'w':
+            warmup = atof(optarg);
+            break;
+        case 'c':
+            tiles_cache_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p path_file] [-w warmup_sec] "
+                            "[-c tiles_cache_dir] [skydata_dir]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (optind < argc) dir = argv[optind];
+
+    nb_keys = parse_path(path_str ?: DEFAULT_PATH, &keys);
+    if (!nb_keys) {
+        fprintf(stderr, "Empty camera path\n");
+        return -1;
+    }
+    for (i = 0; i < nb_keys; i++) nb_frames += keys[i].nb_frames;
+
+    core_init(800, 600, 1);
+    if (tiles_cache_dir) hips_set_tile_cache_dir(tiles_cache_dir);
+    obj_set_attr(&core->obj, "time_speed", 0.0);
+    add_source(dir, "stars", "stars", NULL);
+    add_source(dir, "skycultures", "skycultures/western", "western");
+    add_source(dir, "dsos", "dso", NULL);
+    add_source(dir, "landscapes", "landscapes/guereins", "guereins");
+    add_source(dir, "milkyway", "surveys/milkyway", NULL);
+    add_source(dir, "minor_planets", "mpcorb.dat", "mpc_asteroids");
+    add_source(dir, "planets", "surveys/sso/moon", "moon");
+    add_source(dir, "planets", "surveys/sso/sun", "sun");
+    add_source(dir, "planets", "surveys/sso/moon", "default");
+    add_source(dir, "comets", "CometEls.txt", "mpc_comets");
+
+    // Warm up at the first key frame, until all the data is loaded.
+    set_view(&keys[0]);
+    t = sys_get_unix_time();
+    do {
+        render_frame(NULL);
+    } while (sys_get_unix_time() - t < warmup &&
+             progressbar_list(NULL, on_progressbar));
+    if (tiles_cache_dir)
+        printf("warm up: %.3f s\n", sys_get_unix_time() - t);
+
+    frames = calloc(nb_frames, sizeof(*frames));
+    nb_frames = 0;
+    for (i = 0; i < nb_keys; i++) {
+        for (j = 1; j <= keys[i].nb_frames; j++) {
+            k = keys[i];
+            if (i > 0) {
+                t = (double)j / keys[i].nb_frames;
+                k.yaw = mix(keys[i - 1].yaw, keys[i].yaw, t);
+                k.pitch = mix(keys[i - 1].pitch, keys[i].pitch, t);
+                k.fov = mix(keys[i - 1].fov, keys[i].fov, t);
+                if (!isnan(keys[i - 1].utc) && !isnan(keys[i].utc))
+                    k.utc = mix(keys[i - 1].utc, keys[i].utc, t);
+            }
+            set_view(&k);
+            render_frame(&frames[nb_frames++]);
+        }
+    }
+
+    print_report(nb_frames, frames);
+
+    for (i = 0; i < nb_frames; i++) free(frames[i].modules_times);
+    free(frames);
+    for (i = 0; i < g.nb_modules; i++) free(g.modules[i]);
+    free(g.modules);
+    free(keys);
+    free(path_str);
+    core_release();
+    return 0;
+}
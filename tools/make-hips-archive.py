@@ -0,0 +1,118 @@
+#!/usr/bin/python3
+
+# Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+#
+# This program is licensed under the terms of the GNU AGPL v3, or
+# alternatively under a commercial licence.
+#
+# The terms of the AGPL v3 license can be found in the main directory of this
+# repository.
+
+# Pack a local HiPS survey directory into a single archive file, that can
+# be directly passed to hips_create instead of the directory.
+#
+# Usage:
+#   ./tools/make-hips-archive.py <survey_dir> <out.hipsa> [ext]
+#
+# All the 'NorderX/DirY/NpixZ.<ext>' files become indexed tiles, the other
+# files (properties, Allsky, ...) are stored by path.  If ext is not given,
+# we use the first value of the 'hips_tile_format' property, or 'eph' for
+# the stars and dso surveys.
+#
+# See src/hips_archive.c for the format.
+
+import os
+import re
+import struct
+import sys
+
+VERSION = 1
+HEADER_SIZE = 32
+TILE_ENTRY_SIZE = 24
+FILE_ENTRY_SIZE = 80
+FILE_NAME_SIZE = 64
+
+
+def read_properties(path):
+    ret = {}
+    if not os.path.exists(path):
+        return ret
+    for line in open(path, encoding='utf-8', errors='replace'):
+        line = line.strip()
+        if not line or line.startswith('#') or '=' not in line:
+            continue
+        key, value = line.split('=', 1)
+        ret[key.strip()] = value.strip()
+    return ret
+
+
+def get_tiles_ext(survey_dir):
+    props = read_properties(os.path.join(survey_dir, 'properties'))
+    formats = props.get('hips_tile_format', '').split()
+    if formats:
+        return {'jpeg': 'jpg'}.get(formats[0], formats[0])
+    return 'eph'
+
+
+def list_files(survey_dir, ext):
+    tile_re = re.compile(r'^Norder(\d+)/Dir\d+/Npix(\d+)\.%s$' %
+                         re.escape(ext))
+    tiles = {}
+    files = []
+    for root, dirs, names in os.walk(survey_dir):
+        dirs.sort()
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, survey_dir).replace(os.sep, '/')
+            m = tile_re.match(rel)
+            if m:
+                order, pix = int(m.group(1)), int(m.group(2))
+                tiles[pix + 4 * (1 << (2 * order))] = path
+            elif rel.startswith('Norder') and '/Dir' in rel:
+                continue # Tile with an other format.
+            elif len(rel.encode()) < FILE_NAME_SIZE:
+                files.append((rel, path))
+            else:
+                print('Skip %s: path too long' % rel)
+    return tiles, files
+
+
+def main():
+    if len(sys.argv) < 3:
+        print('Usage: %s <survey_dir> <out.hipsa> [ext]' % sys.argv[0])
+        sys.exit(-1)
+    survey_dir, out = sys.argv[1], sys.argv[2]
+    ext = sys.argv[3] if len(sys.argv) > 3 else get_tiles_ext(survey_dir)
+    tiles, files = list_files(survey_dir, ext)
+
+    tiles_ofs = HEADER_SIZE
+    files_ofs = tiles_ofs + len(tiles) * TILE_ENTRY_SIZE
+    data_ofs = files_ofs + len(files) * FILE_ENTRY_SIZE
+
+    with open(out, 'wb') as f:
+        f.write(struct.pack('<4sIIIQQ', b'HIPA', VERSION, len(tiles),
+                            len(files), tiles_ofs, files_ofs))
+        # Write the blocks after the index, and come back to the index
+        # once we know the offsets.
+        f.seek(data_ofs)
+        tiles_index = []
+        for nuniq in sorted(tiles):
+            data = open(tiles[nuniq], 'rb').read()
+            tiles_index.append(struct.pack('<QQQ', nuniq, f.tell(),
+                                           len(data)))
+            f.write(data + b'\0')
+        files_index = []
+        for name, path in files:
+            data = open(path, 'rb').read()
+            files_index.append(struct.pack('<64sQQ', name.encode(),
+                                           f.tell(), len(data)))
+            f.write(data + b'\0')
+        f.seek(tiles_ofs)
+        f.write(b''.join(tiles_index))
+        f.write(b''.join(files_index))
+
+    print('%s: %d tiles (%s), %d files' % (out, len(tiles), ext, len(files)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,160 @@
+#!/usr/bin/python3
+
+# Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+#
+# This program is licensed under the terms of the GNU AGPL v3, or
+# alternatively under a commercial licence.
+#
+# The terms of the AGPL v3 license can be found in the main directory of this
+# repository.
+
+# Split the tiles of a local stars survey directory into magnitude chunks.
+#
+# Usage:
+#   ./tools/make-stars-chunks.py <survey_dir> [mag_step] [min_rows]
+#
+# The STAR and GAIA chunks of each tile are sorted by magnitude, and split
+# into several chunks of 'mag_step' magnitudes (default 1), merging the
+# chunks of less than 'min_rows' stars (default 512) with the next one.
+# The engine then only decodes the faint stars of a tile when the limiting
+# magnitude reaches them.  The tiles are modified in place.
+#
+# Run this before make-stars-index.py, since the index rows depend on the
+# order of the stars in the tiles.
+#
+# See src/eph-file.c for the format.
+
+import math
+import os
+import re
+import struct
+import sys
+import zlib
+
+EPH_VERSION = 2
+CHUNK_VERSION = 4
+
+
+def shuffle(data, n_row, row_size):
+    '''Same as eph_shuffle_bytes.'''
+    return bytes(data[i * row_size + j] for j in range(row_size)
+                 for i in range(n_row))
+
+
+def unshuffle(data, n_row, row_size):
+    return bytes(data[j * n_row + i] for i in range(n_row)
+                 for j in range(row_size))
+
+
+def split_table(chunk, ofs, mag_step, min_rows):
+    '''Split an eph tabular data chunk into magnitude sorted tables.
+
+    Return a list of (mag_min, mag_max, table data).
+    '''
+    flags, row_size, n_col, n_row = struct.unpack_from('<iiii', chunk, ofs)
+    columns_data = chunk[ofs + 16:ofs + 16 + n_col * 20]
+    columns = {}
+    for i in range(n_col):
+        name, type_, unit, start, size = struct.unpack_from(
+                '<4s4sIii', columns_data, i * 20)
+        columns[name.rstrip(b'\0').decode()] = start
+    ofs += 16 + n_col * 20
+    size, comp_size = struct.unpack_from('<ii', chunk, ofs)
+    table = zlib.decompress(chunk[ofs + 8:ofs + 8 + comp_size])
+    assert len(table) == size
+    if flags & 1:
+        table = unshuffle(table, n_row, row_size)
+    rows = [table[i * row_size:(i + 1) * row_size] for i in range(n_row)]
+
+    def get_mag(row):
+        vmag = math.nan
+        if 'vmag' in columns:
+            vmag = struct.unpack_from('<f', row, columns['vmag'])[0]
+        if math.isnan(vmag):
+            vmag = struct.unpack_from('<f', row, columns['gmag'])[0]
+        return vmag
+
+    rows = sorted(((get_mag(r), i, r) for i, r in enumerate(rows)),
+                  key=lambda x: (x[0], x[1]))
+
+    # Group the rows by magnitude steps.
+    groups = []
+    for vmag, i, row in rows:
+        key = math.floor(vmag / mag_step)
+        if groups and (groups[-1][0] == key or len(groups[-1][1]) < min_rows):
+            groups[-1][1].append((vmag, row))
+        else:
+            groups.append([key, [(vmag, row)]])
+    # The last group can be too small too.
+    if len(groups) > 1 and len(groups[-1][1]) < min_rows:
+        groups[-2][1].extend(groups.pop()[1])
+
+    ret = []
+    for key, group in groups:
+        data = b''.join(row for vmag, row in group)
+        if flags & 1:
+            data = shuffle(data, len(group), row_size)
+        comp = zlib.compress(data)
+        table = struct.pack('<iiii', flags, row_size, n_col, len(group))
+        table += columns_data
+        table += struct.pack('<ii', len(data), len(comp)) + comp
+        ret.append((group[0][0], group[-1][0], table))
+    return ret
+
+
+def write_chunk(out, type_, data):
+    out.append(struct.pack('<4si', type_, len(data)) + data +
+               struct.pack('<I', 0))
+
+
+def process_tile(path, mag_step, min_rows):
+    '''Rewrite a tile file, return the number of chunks written.'''
+    data = open(path, 'rb').read()
+    assert data[:4] == b'EPHE'
+    assert struct.unpack_from('<i', data, 4)[0] == EPH_VERSION
+    out = [data[:8]]
+    ofs = 8
+    nb = 0
+    while ofs < len(data):
+        type_, size = struct.unpack_from('<4si', data, ofs)
+        chunk = data[ofs + 8:ofs + 8 + size]
+        ofs += size + 12
+        if type_ not in (b'STAR', b'GAIA'):
+            write_chunk(out, type_, chunk)
+            continue
+        version, nuniq = struct.unpack_from('<iQ', chunk, 0)
+        if version >= CHUNK_VERSION:
+            print('%s: already split' % path)
+            return 0
+        for mag_min, mag_max, table in split_table(chunk, 12, mag_step,
+                                                   min_rows):
+            header = struct.pack('<iQff', CHUNK_VERSION, nuniq,
+                                 mag_min, mag_max)
+            write_chunk(out, type_, header + table)
+            nb += 1
+    open(path, 'wb').write(b''.join(out))
+    return nb
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: %s <survey_dir> [mag_step] [min_rows]' % sys.argv[0])
+        sys.exit(-1)
+    survey_dir = sys.argv[1]
+    mag_step = float(sys.argv[2]) if len(sys.argv) > 2 else 1.0
+    min_rows = int(sys.argv[3]) if len(sys.argv) > 3 else 512
+    tile_re = re.compile(r'^Npix\d+\.eph$')
+
+    nb_tiles = nb_chunks = 0
+    for root, dirs, names in os.walk(survey_dir):
+        for fname in names:
+            if not tile_re.match(fname):
+                continue
+            nb_chunks += process_tile(os.path.join(root, fname),
+                                      mag_step, min_rows)
+            nb_tiles += 1
+    print('%d tiles, %d chunks' % (nb_tiles, nb_chunks))
+
+
+if __name__ == '__main__':
+    main()
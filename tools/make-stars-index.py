@@ -0,0 +1,142 @@
+#!/usr/bin/python3
+
+# Stellarium Web Engine - Copyright (c) 2022 - Stellarium Labs SRL
+#
+# This program is licensed under the terms of the GNU AGPL v3, or
+# alternatively under a commercial licence.
+#
+# The terms of the AGPL v3 license can be found in the main directory of this
+# repository.
+
+# Create the HIP and Gaia ids index of a local stars survey directory.
+#
+# Usage:
+#   ./tools/make-stars-index.py <survey_dir> [name]
+#
+# The index is written in the survey directory (default name: 'ids.idx'),
+# and the 'ids_index' property is added to the survey properties file so
+# that the engine can find it.  Run this before packing the survey with
+# make-hips-archive.py, and after make-stars-chunks.py if the tiles are split
+# into magnitude chunks.
+#
+# See src/stars_index.c for the format.
+
+import math
+import os
+import re
+import struct
+import sys
+import zlib
+
+VERSION = 1
+EPH_VERSION = 2
+
+
+def parse_table(data, ofs):
+    '''Parse an eph tabular data chunk (see src/eph-file.c).
+
+    Return the list of the tile rows, as dict of the values we need.
+    '''
+    flags, row_size, n_col, n_row = struct.unpack_from('<iiii', data, ofs)
+    ofs += 16
+    columns = {}
+    for i in range(n_col):
+        name, type_, unit, start, size = struct.unpack_from(
+                '<4s4sIii', data, ofs + i * 20)
+        columns[name.rstrip(b'\0').decode()] = (type_[:1], start, size)
+    ofs += n_col * 20
+    size, comp_size = struct.unpack_from('<ii', data, ofs)
+    table = zlib.decompress(data[ofs + 8:ofs + 8 + comp_size])
+    assert len(table) == size
+
+    def get(name, row):
+        if name not in columns:
+            return None
+        type_, start, size = columns[name]
+        size = {b'f': 4, b'i': 4, b'Q': 8}[type_]
+        if flags & 1: # Shuffled data.
+            raw = bytes(table[(start + k) * n_row + row] for k in range(size))
+        else:
+            raw = table[row * row_size + start:row * row_size + start + size]
+        return struct.unpack({b'f': '<f', b'i': '<i', b'Q': '<Q'}[type_],
+                             raw)[0]
+
+    rows = []
+    for row in range(n_row):
+        vmag = get('vmag', row)
+        if vmag is None or math.isnan(vmag):
+            vmag = get('gmag', row)
+        rows.append({'row': row, 'vmag': vmag,
+                     'hip': get('hip', row) or 0,
+                     'gaia': get('gaia', row) or 0})
+    return rows
+
+
+def parse_tile(path):
+    '''Return the list of (nuniq, hip, gaia, row) of a tile file.'''
+    data = open(path, 'rb').read()
+    assert data[:4] == b'EPHE'
+    assert struct.unpack_from('<i', data, 4)[0] == EPH_VERSION
+    ofs = 8
+    ret = []
+    while ofs < len(data):
+        type_, size = struct.unpack_from('<4si', data, ofs)
+        chunk = data[ofs + 8:ofs + 8 + size]
+        ofs += size + 12
+        if type_ not in (b'STAR', b'GAIA'):
+            continue
+        version, nuniq = struct.unpack_from('<iQ', chunk, 0)
+        # Version 4 chunks have the magnitude range after the header (see
+        # make-stars-chunks.py).
+        rows = parse_table(chunk, 20 if version >= 4 else 12)
+        # The engine sorts the rows of each chunk by magnitude when loading
+        # a tile, and appends the chunks.
+        rows.sort(key=lambda r: (r['vmag'], r['row']))
+        start = len(ret)
+        for i, r in enumerate(rows):
+            ret.append((nuniq, r['hip'], r['gaia'], start + i))
+    return ret
+
+
+def add_property(survey_dir, name):
+    path = os.path.join(survey_dir, 'properties')
+    lines = open(path).read().splitlines() if os.path.exists(path) else []
+    lines = [x for x in lines if x.split('=')[0].strip() != 'ids_index']
+    lines.append('%-25s= %s' % ('ids_index', name))
+    open(path, 'w').write('\n'.join(lines) + '\n')
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: %s <survey_dir> [name]' % sys.argv[0])
+        sys.exit(-1)
+    survey_dir = sys.argv[1]
+    name = sys.argv[2] if len(sys.argv) > 2 else 'ids.idx'
+    tile_re = re.compile(r'^Npix\d+\.eph$')
+
+    hips, gaias = {}, {}
+    for root, dirs, names in os.walk(survey_dir):
+        dirs.sort()
+        for fname in sorted(names):
+            if not tile_re.match(fname):
+                continue
+            for nuniq, hip, gaia, row in parse_tile(os.path.join(root, fname)):
+                # If a star is in several tiles, keep the lowest order one.
+                if hip and (hip not in hips or nuniq < hips[hip][0]):
+                    hips[hip] = (nuniq, row)
+                if gaia and (gaia not in gaias or nuniq < gaias[gaia][0]):
+                    gaias[gaia] = (nuniq, row)
+
+    with open(os.path.join(survey_dir, name), 'wb') as f:
+        f.write(struct.pack('<4sIII', b'STID', VERSION, len(hips),
+                            len(gaias)))
+        f.write(b''.join(struct.pack('<III', hip, *hips[hip])
+                         for hip in sorted(hips)))
+        f.write(b''.join(struct.pack('<QII', gaia, *gaias[gaia])
+                         for gaia in sorted(gaias)))
+    add_property(survey_dir, name)
+    print('%s: %d HIP, %d Gaia ids' % (name, len(hips), len(gaias)))
+
+
+if __name__ == '__main__':
+    main()